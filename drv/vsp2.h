@@ -76,7 +76,15 @@ struct clk;
 struct device;
 
 struct vsp2_bru;
+struct vsp2_clu;
+struct vsp2_hgo;
+struct vsp2_hgt;
+struct vsp2_hsi;
+struct vsp2_hst;
+struct vsp2_lif;
+struct vsp2_lut;
 struct vsp2_rwpf;
+struct vsp2_sru;
 struct vsp2_uds;
 struct vsp2_vspm;
 
@@ -90,6 +98,76 @@ struct vsp2_vspm;
 #define VSP2_COUNT_UDS		1
 #define VSP2_COUNT_WPF		1
 
+/* Driver private controls */
+#define V4L2_CID_VSP2_BASE		(V4L2_CID_USER_BASE | 0x1000)
+#define V4L2_CID_VSP2_FRAME_SEQUENCE	(V4L2_CID_VSP2_BASE + 0)
+#define V4L2_CID_VSP2_FRAME_START	(V4L2_CID_VSP2_BASE + 1)
+#define V4L2_CID_VSP2_FRAME_END		(V4L2_CID_VSP2_BASE + 2)
+#define V4L2_CID_VSP2_DAMAGE_LEFT	(V4L2_CID_VSP2_BASE + 3)
+#define V4L2_CID_VSP2_DAMAGE_TOP	(V4L2_CID_VSP2_BASE + 4)
+#define V4L2_CID_VSP2_DAMAGE_WIDTH	(V4L2_CID_VSP2_BASE + 5)
+#define V4L2_CID_VSP2_DAMAGE_HEIGHT	(V4L2_CID_VSP2_BASE + 6)
+#define V4L2_CID_VSP2_SKIP_REDUNDANT	(V4L2_CID_VSP2_BASE + 7)
+#define V4L2_CID_VSP2_SKIPPED_JOBS	(V4L2_CID_VSP2_BASE + 8)
+#define V4L2_CID_VSP2_REQUEST_MODE	(V4L2_CID_VSP2_BASE + 9)
+#define V4L2_CID_VSP2_PRESET		(V4L2_CID_VSP2_BASE + 10)
+#define V4L2_CID_VSP2_PRESET_STORE	(V4L2_CID_VSP2_BASE + 11)
+#define V4L2_CID_VSP2_SRU_INTENSITY	(V4L2_CID_VSP2_BASE + 12)
+#define V4L2_CID_VSP2_LUT_TABLE		(V4L2_CID_VSP2_BASE + 13)
+#define V4L2_CID_VSP2_CLU_TABLE		(V4L2_CID_VSP2_BASE + 14)
+#define V4L2_CID_VSP2_CLU_UPDATE	(V4L2_CID_VSP2_BASE + 15)
+#define V4L2_CID_VSP2_BRU_ZORDER(n)	(V4L2_CID_VSP2_BASE + 0x10 + (n))
+#define V4L2_CID_VSP2_BRU_ENABLE(n)	(V4L2_CID_VSP2_BASE + 0x14 + (n))
+#define V4L2_CID_VSP2_BRU_BLEND(n)	(V4L2_CID_VSP2_BASE + 0x18 + (n))
+#define V4L2_CID_VSP2_BRU_ROP(n)	(V4L2_CID_VSP2_BASE + 0x1c + (n))
+#define V4L2_CID_VSP2_HGO_MAX_RGB	(V4L2_CID_VSP2_BASE + 0x20)
+#define V4L2_CID_VSP2_HGT_HUE_AREAS	(V4L2_CID_VSP2_BASE + 0x21)
+#define V4L2_CID_VSP2_RPF_VIRTUAL	(V4L2_CID_VSP2_BASE + 0x22)
+#define V4L2_CID_VSP2_RPF_VIRTUAL_COLOR	(V4L2_CID_VSP2_BASE + 0x23)
+#define V4L2_CID_VSP2_BRU_COEF(n)	(V4L2_CID_VSP2_BASE + 0x24 + (n))
+#define V4L2_CID_VSP2_RPF_PALETTE	(V4L2_CID_VSP2_BASE + 0x28)
+#define V4L2_CID_VSP2_RPF_CKEY_ENABLE	(V4L2_CID_VSP2_BASE + 0x29)
+#define V4L2_CID_VSP2_RPF_CKEY_COLOR	(V4L2_CID_VSP2_BASE + 0x2a)
+#define V4L2_CID_VSP2_PRESET_LOAD	(V4L2_CID_VSP2_BASE + 0x2b)
+
+/* BRU blending modes, selected by the V4L2_CID_VSP2_BRU_BLEND controls */
+enum vsp2_bru_blend {
+	VSP2_BRU_BLEND_ALPHA = 0,
+	VSP2_BRU_BLEND_ADDITIVE = 1,
+	VSP2_BRU_BLEND_CONSTANT = 2,
+};
+
+/* Histogram buffer format delivered by the HGO video node. The buffer holds
+ * the HGO result registers from VI6_HGO_R_HISTO to VI6_HGO_B_LB_DET as 32-bit
+ * words: for each of the R, G and B (or V, Y and U) components, 64 histogram
+ * bins followed by the max/min, sum and detection count words. Consecutive
+ * components are separated by one reserved word.
+ */
+#define V4L2_PIX_FMT_VSP2_HGO		v4l2_fourcc('V', 'H', 'G', 'O')
+
+/* Histogram buffer format delivered by the HGT video node. The buffer holds
+ * the HGT result registers from VI6_HGT_HISTO(0, 0) to VI6_HGT_LB_DET as
+ * 32-bit words: 32 saturation bins for each of the 6 hue areas, followed by
+ * the max/min, sum and detection count words.
+ */
+#define V4L2_PIX_FMT_VSP2_HGT		v4l2_fourcc('V', 'H', 'G', 'T')
+
+/* Input formats with an external alpha plane. The color planes are laid out as
+ * in the corresponding standard format and are followed by an additional plane
+ * holding the 8-bit alpha component of each pixel, with no subsampling.
+ */
+#define V4L2_PIX_FMT_VSP2_RGB565_A8	v4l2_fourcc('V', 'R', '6', 'A')
+#define V4L2_PIX_FMT_VSP2_RGB24_A8	v4l2_fourcc('V', 'R', '3', 'A')
+#define V4L2_PIX_FMT_VSP2_XRGB32_A8	v4l2_fourcc('V', 'X', '4', 'A')
+#define V4L2_PIX_FMT_VSP2_NV12M_A8	v4l2_fourcc('V', 'N', '2', 'A')
+
+/* 8-bit indexed input format with a YUV palette. The pixels are looked up in
+ * the RPF palette, set through the V4L2_CID_VSP2_RPF_PALETTE control, whose
+ * entries are expressed as 0xAAYYUUVV. The V4L2_PIX_FMT_PAL8 format uses the
+ * same palette with 0xAARRGGBB entries.
+ */
+#define V4L2_PIX_FMT_VSP2_YUV_PAL8	v4l2_fourcc('V', 'Y', 'P', '8')
+
 struct vsp2_device {
 	struct device *dev;
 
@@ -97,7 +175,15 @@ struct vsp2_device {
 	int ref_count;
 
 	struct vsp2_bru *bru;
+	struct vsp2_clu *clu;
+	struct vsp2_hgo *hgo;
+	struct vsp2_hgt *hgt;
+	struct vsp2_hsi *hsi;
+	struct vsp2_hst *hst;
+	struct vsp2_lif *lif;
+	struct vsp2_lut *lut;
 	struct vsp2_rwpf *rpf[VSP2_COUNT_RPF];
+	struct vsp2_sru *sru;
 	struct vsp2_uds *uds[VSP2_COUNT_UDS];
 	struct vsp2_rwpf *wpf[VSP2_COUNT_WPF];
 
@@ -80,28 +80,182 @@ static int bru_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct vsp2_bru *bru =
 		container_of(ctrl->handler, struct vsp2_bru, ctrls);
-	VSPM_VSP_PAR *vsp_par =
-		bru->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
-	T_VSP_BRU *vsp_bru = vsp_par->ctrl_par->bru;
+	struct vsp2_pipeline *pipe;
+	unsigned int input;
+
+	/* The inputs stacking order is applied when building each job. */
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_BRU_ZORDER(0):
+	case V4L2_CID_VSP2_BRU_ZORDER(1):
+	case V4L2_CID_VSP2_BRU_ZORDER(2):
+	case V4L2_CID_VSP2_BRU_ZORDER(3):
+		bru->inputs[ctrl->id - V4L2_CID_VSP2_BRU_ZORDER(0)].zorder =
+			ctrl->val;
+		return 0;
+
+	case V4L2_CID_VSP2_BRU_ENABLE(0):
+	case V4L2_CID_VSP2_BRU_ENABLE(1):
+	case V4L2_CID_VSP2_BRU_ENABLE(2):
+	case V4L2_CID_VSP2_BRU_ENABLE(3):
+		input = ctrl->id - V4L2_CID_VSP2_BRU_ENABLE(0);
+		if (!vsp2_entity_is_streaming(&bru->entity)) {
+			bru->inputs[input].enabled = ctrl->val;
+			return 0;
+		}
+
+		pipe = to_vsp2_pipeline(&bru->entity.subdev.entity);
+		return vsp2_pipeline_enable_input(pipe, bru, input, ctrl->val);
+
+	/* The blending and raster operations are applied when building each
+	 * job. They aren't part of the job description, the next job can't be
+	 * skipped.
+	 */
+	case V4L2_CID_VSP2_BRU_BLEND(0):
+	case V4L2_CID_VSP2_BRU_BLEND(1):
+	case V4L2_CID_VSP2_BRU_BLEND(2):
+	case V4L2_CID_VSP2_BRU_BLEND(3):
+		bru->inputs[ctrl->id - V4L2_CID_VSP2_BRU_BLEND(0)].blend =
+			ctrl->val;
+		break;
+
+	case V4L2_CID_VSP2_BRU_ROP(0):
+	case V4L2_CID_VSP2_BRU_ROP(1):
+	case V4L2_CID_VSP2_BRU_ROP(2):
+	case V4L2_CID_VSP2_BRU_ROP(3):
+		bru->inputs[ctrl->id - V4L2_CID_VSP2_BRU_ROP(0)].rop =
+			ctrl->val;
+		break;
+
+	case V4L2_CID_VSP2_BRU_COEF(0):
+	case V4L2_CID_VSP2_BRU_COEF(1):
+	case V4L2_CID_VSP2_BRU_COEF(2):
+	case V4L2_CID_VSP2_BRU_COEF(3):
+		bru->inputs[ctrl->id - V4L2_CID_VSP2_BRU_COEF(0)].coef =
+			ctrl->val;
+		break;
+	}
 
 	if (!vsp2_entity_is_streaming(&bru->entity))
 		return 0;
 
+	pipe = to_vsp2_pipeline(&bru->entity.subdev.entity);
+
 	switch (ctrl->id) {
 	case V4L2_CID_BG_COLOR:
-		vsp_bru->blend_virtual->color =
-			ctrl->val | (0xff << VI6_BRU_VIRRPF_COL_A_SHIFT);
-		bru->bgcolor = ctrl->val;
+		vsp2_pipeline_set_bgcolor(pipe, bru, ctrl->val);
+		break;
+
+	default:
+		vsp2_pipeline_invalidate_job(pipe);
 		break;
 	}
 
 	return 0;
 }
 
+/*
+ * vsp2_bru_set_bgcolor - Set the BRU background color
+ * @bru: the BRU
+ * @bgcolor: the background color in RGB888 format
+ */
+void vsp2_bru_set_bgcolor(struct vsp2_bru *bru, u32 bgcolor)
+{
+	VSPM_VSP_PAR *vsp_par =
+		bru->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_BRU *vsp_bru = vsp_par->ctrl_par->bru;
+
+	vsp_bru->blend_virtual->color =
+		bgcolor | (0xff << VI6_BRU_VIRRPF_COL_A_SHIFT);
+	bru->bgcolor = bgcolor;
+}
+
 static const struct v4l2_ctrl_ops bru_ctrl_ops = {
 	.s_ctrl = bru_s_ctrl,
 };
 
+/*
+ * The Z-order controls set the stacking order of the BRU inputs in the
+ * composed image, from 0 (bottom) to 3 (top). Inputs with the same Z-order are
+ * stacked in input index order.
+ */
+static const char * const bru_zorder_names[] = {
+	"Input 0 Z-Order",
+	"Input 1 Z-Order",
+	"Input 2 Z-Order",
+	"Input 3 Z-Order",
+};
+
+/*
+ * The enable controls add and remove BRU inputs while streaming without
+ * modifying the links. A disabled input is left out of the jobs and its video
+ * node buffers are held until it gets enabled again.
+ */
+static const char * const bru_enable_names[] = {
+	"Input 0 Enable",
+	"Input 1 Enable",
+	"Input 2 Enable",
+	"Input 3 Enable",
+};
+
+/*
+ * The blend controls select the formula used to blend each input over the
+ * layers below it (see enum vsp2_bru_blend). The constant alpha mode weights
+ * the input with the blend coefficient control value instead of its alpha
+ * component.
+ */
+static const char * const bru_blend_names[] = {
+	"Input 0 Blend Mode",
+	"Input 1 Blend Mode",
+	"Input 2 Blend Mode",
+	"Input 3 Blend Mode",
+};
+
+static const char * const bru_blend_menu[] = {
+	"Alpha Blending",
+	"Additive",
+	"Constant Alpha",
+	NULL,
+};
+
+static const char * const bru_coef_names[] = {
+	"Input 0 Blend Coefficient",
+	"Input 1 Blend Coefficient",
+	"Input 2 Blend Coefficient",
+	"Input 3 Blend Coefficient",
+};
+
+/*
+ * The ROP controls replace blending by a raster operation between the input
+ * (SRC) and the layers below it (DST), applied to all components. The menu
+ * index is the hardware ROP code, the NOP code selects blending.
+ */
+static const char * const bru_rop_names[] = {
+	"Input 0 Raster Operation",
+	"Input 1 Raster Operation",
+	"Input 2 Raster Operation",
+	"Input 3 Raster Operation",
+};
+
+static const char * const bru_rop_menu[] = {
+	[VI6_ROP_NOP] = "Disabled (Blend)",
+	[VI6_ROP_AND] = "AND",
+	[VI6_ROP_AND_REV] = "AND Reverse",
+	[VI6_ROP_COPY] = "Copy",
+	[VI6_ROP_AND_INV] = "AND Inverted",
+	[VI6_ROP_CLEAR] = "Clear",
+	[VI6_ROP_XOR] = "XOR",
+	[VI6_ROP_OR] = "OR",
+	[VI6_ROP_NOR] = "NOR",
+	[VI6_ROP_EQUIV] = "Equivalent",
+	[VI6_ROP_INVERT] = "Invert",
+	[VI6_ROP_OR_REV] = "OR Reverse",
+	[VI6_ROP_COPY_INV] = "Copy Inverted",
+	[VI6_ROP_OR_INV] = "OR Inverted",
+	[VI6_ROP_NAND] = "NAND",
+	[VI6_ROP_SET] = "Set",
+	NULL,
+};
+
 /* -----------------------------------------------------------------------------
  * V4L2 Subdevice Core Operations
  */
@@ -110,9 +264,7 @@ static int bru_s_stream(struct v4l2_subdev *subdev, int enable)
 {
 	struct vsp2_pipeline *pipe = to_vsp2_pipeline(&subdev->entity);
 	struct vsp2_bru *bru = to_bru(subdev);
-	struct v4l2_mbus_framefmt *format;
 	unsigned int flags;
-	unsigned int i;
 	int ret;
 	VSPM_VSP_PAR *vsp_par =
 		bru->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
@@ -126,8 +278,6 @@ static int bru_s_stream(struct v4l2_subdev *subdev, int enable)
 	if (!enable)
 		return 0;
 
-	format = &bru->entity.formats[BRU_PAD_SOURCE];
-
 	/* The hardware is extremely flexible but we have no userspace API to
 	 * expose all the parameters, nor is it clear whether we would have use
 	 * cases for all the supported modes. Let's just harcode the parameters
@@ -150,23 +300,122 @@ static int bru_s_stream(struct v4l2_subdev *subdev, int enable)
 	vsp_bru->dith[2] = (inctrl & (0x000F <<  8)) >>  8;
 	vsp_bru->dith[3] = (inctrl & (0x000F << 12)) >> 12;
 
-	/* Set the background position to cover the whole output image. */
-	vsp_bru->blend_virtual->width		= format->width;
-	vsp_bru->blend_virtual->height		= format->height;
+	/* The background size and the Blend/ROP units configuration depend on
+	 * the layers composed by each job and are set by vsp2_bru_configure().
+	 */
 	vsp_bru->blend_virtual->x_position	= 0;
 	vsp_bru->blend_virtual->y_position	= 0;
 	vsp_bru->blend_virtual->pwd		= VSP_LAYER_PARENT;
 	vsp_bru->blend_virtual->color =
 		bru->bgcolor | (0xff << VI6_BRU_VIRRPF_COL_A_SHIFT);
 
-	/* Route BRU input 1 as SRC input to the ROP unit and configure the ROP
-	 * unit with a NOP operation to make BRU input 1 available as the
-	 * Blend/ROP unit B SRC input.
-	 */
-	vsp_bru->blend_rop = NULL;
+	return 0;
+}
+
+/*
+ * bru_set_blend - Configure the blending formula of a Blend/ROP unit
+ * @vsp_bru_ctrl: the Blend/ROP unit parameters
+ * @blend: the blending mode
+ * @coef: the constant alpha value, for the constant alpha mode
+ * @premultiplied: whether the SRC input color is premultiplied by its alpha
+ *
+ * The fixed coefficients are shared by the color and alpha formulas.
+ */
+static void bru_set_blend(T_VSP_BLEND_CONTROL *vsp_bru_ctrl,
+			  unsigned int blend, unsigned int coef,
+			  bool premultiplied)
+{
+	vsp_bru_ctrl->blend_formula = VSP_FORM_BLEND0;
+	vsp_bru_ctrl->aformula = VSP_FORM_ALPHA0;
+
+	switch (blend) {
+	case VSP2_BRU_BLEND_ADDITIVE:
+		/* DSTc = DSTc + SRCc * SRCa (DSTc + SRCc when premultiplied)
+		 * DSTa = DSTa + SRCa
+		 */
+		vsp_bru_ctrl->blend_coefx = VSP_COEFFICIENT_BLENDX5;
+		vsp_bru_ctrl->blend_coefy = premultiplied ?
+			VSP_COEFFICIENT_BLENDY5 : VSP_COEFFICIENT_BLENDY3;
+		vsp_bru_ctrl->acoefx = VSP_COEFFICIENT_ALPHAX5;
+		vsp_bru_ctrl->acoefy = VSP_COEFFICIENT_ALPHAY5;
+		vsp_bru_ctrl->acoefx_fix = 0xFF;
+		vsp_bru_ctrl->acoefy_fix = 0xFF;
+		break;
+
+	case VSP2_BRU_BLEND_CONSTANT:
+		/* DSTc = DSTc * (1 - coef) + SRCc * coef
+		 * DSTa = DSTa * (1 - coef) + SRCa * coef
+		 */
+		vsp_bru_ctrl->blend_coefx = VSP_COEFFICIENT_BLENDX5;
+		vsp_bru_ctrl->blend_coefy = VSP_COEFFICIENT_BLENDY5;
+		vsp_bru_ctrl->acoefx = VSP_COEFFICIENT_ALPHAX5;
+		vsp_bru_ctrl->acoefy = VSP_COEFFICIENT_ALPHAY5;
+		vsp_bru_ctrl->acoefx_fix = 0xFF - coef;
+		vsp_bru_ctrl->acoefy_fix = coef;
+		break;
+
+	case VSP2_BRU_BLEND_ALPHA:
+	default:
+		/* DSTc = DSTc * (1 - SRCa) + SRCc * SRCa
+		 * DSTa = DSTa * (1 - SRCa) + SRCa
+		 *
+		 * when the SRC input isn't premultiplied, and
+		 *
+		 * DSTc = DSTc * (1 - SRCa) + SRCc
+		 * DSTa = DSTa * (1 - SRCa) + SRCa
+		 *
+		 * otherwise.
+		 */
+		vsp_bru_ctrl->blend_coefx = VSP_COEFFICIENT_BLENDX4;
+		vsp_bru_ctrl->blend_coefy = premultiplied ?
+			VSP_COEFFICIENT_BLENDY5 : VSP_COEFFICIENT_BLENDY3;
+		vsp_bru_ctrl->acoefx = VSP_COEFFICIENT_ALPHAX4;
+		vsp_bru_ctrl->acoefy = VSP_COEFFICIENT_ALPHAY5;
+		vsp_bru_ctrl->acoefx_fix = 0;
+		vsp_bru_ctrl->acoefy_fix = 0xFF;
+		break;
+	}
+}
+
+/*
+ * vsp2_bru_configure - Configure the BRU for the next job
+ * @bru: the BRU
+ * @layers: the layers composed by the job, from bottom to top
+ * @num_layers: the number of layers
+ * @window: the size of the composed image, or NULL to compose the whole
+ *	output image
+ *
+ * The VSPM stacks the job sources on top of the virtual RPF in layer order,
+ * the Blend/ROP units are thus configured according to the layer position
+ * rather than to the BRU input they are connected to. The blending and raster
+ * operations set on a BRU input follow the layer it feeds.
+ */
+void vsp2_bru_configure(struct vsp2_bru *bru,
+			const struct vsp2_pipeline_layer *layers,
+			unsigned int num_layers, const struct v4l2_rect *window)
+{
+	struct v4l2_mbus_framefmt *format;
+	unsigned int i;
+	VSPM_VSP_PAR *vsp_par =
+		bru->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_BRU *vsp_bru = vsp_par->ctrl_par->bru;
+
+	/* Set the background position to cover the whole composed image. */
+	if (window) {
+		vsp_bru->blend_virtual->width	= window->width;
+		vsp_bru->blend_virtual->height	= window->height;
+	} else {
+		format = &bru->entity.formats[BRU_PAD_SOURCE];
+		vsp_bru->blend_virtual->width	= format->width;
+		vsp_bru->blend_virtual->height	= format->height;
+	}
 
 	for (i = 0; i < 4; ++i) {
 		bool premultiplied = false;
+		unsigned int blend = VSP2_BRU_BLEND_ALPHA;
+		unsigned int coef = 0xff;
+		unsigned int rop = VI6_ROP_NOP;
+		unsigned int j;
 		u32 ctrl = 0;
 		T_VSP_BLEND_CONTROL *vsp_bru_ctrl = NULL;
 		switch (i) {
@@ -187,15 +436,29 @@ static int bru_s_stream(struct v4l2_subdev *subdev, int enable)
 			break;
 		}
 
-		/* Configure all Blend/ROP units corresponding to an enabled BRU
-		 * input for alpha blending. Blend/ROP units corresponding to
-		 * disabled BRU inputs are used in ROP NOP mode to ignore the
-		 * SRC input.
+		/* Configure all Blend/ROP units corresponding to a composed
+		 * layer for blending, or for the raster operation selected on
+		 * the BRU input feeding the layer. Blend/ROP units without a
+		 * layer are used in ROP NOP mode to ignore the SRC input.
 		 */
-		if (bru->inputs[i].rpf) {
-			ctrl |= VI6_BRU_CTRL_RBC;
-
-			premultiplied = bru->inputs[i].rpf->video.format.flags
+		if (i < num_layers) {
+			for (j = 0; j < ARRAY_SIZE(bru->inputs); ++j) {
+				if (bru->inputs[j].rpf != layers[i].rpf)
+					continue;
+
+				blend = bru->inputs[j].blend;
+				coef = bru->inputs[j].coef;
+				rop = bru->inputs[j].rop;
+				break;
+			}
+
+			if (rop == VI6_ROP_NOP)
+				ctrl |= VI6_BRU_CTRL_RBC;
+			else
+				ctrl |= VI6_BRU_CTRL_CROP(rop)
+				     |  VI6_BRU_CTRL_AROP(rop);
+
+			premultiplied = layers[i].rpf->video.format.flags
 				      & V4L2_PIX_FMT_FLAG_PREMUL_ALPHA;
 		} else {
 			ctrl |= VI6_BRU_CTRL_CROP(VI6_ROP_NOP)
@@ -220,30 +483,8 @@ static int bru_s_stream(struct v4l2_subdev *subdev, int enable)
 		vsp_bru_ctrl->crop = (ctrl & (0xF <<  4)) >>  4;
 		vsp_bru_ctrl->arop = (ctrl & (0xF <<  0)) >>  0;
 
-		/* Harcode the blending formula to
-		 *
-		 *	DSTc = DSTc * (1 - SRCa) + SRCc * SRCa
-		 *	DSTa = DSTa * (1 - SRCa) + SRCa
-		 *
-		 * when the SRC input isn't premultiplied, and to
-		 *
-		 *	DSTc = DSTc * (1 - SRCa) + SRCc
-		 *	DSTa = DSTa * (1 - SRCa) + SRCa
-		 *
-		 * otherwise.
-		 */
-		vsp_bru_ctrl->blend_formula = VSP_FORM_BLEND0;
-		vsp_bru_ctrl->blend_coefx = VSP_COEFFICIENT_BLENDX4;
-		vsp_bru_ctrl->blend_coefy = (premultiplied) ?
-			VSP_COEFFICIENT_BLENDY5 : VSP_COEFFICIENT_BLENDY3;
-		vsp_bru_ctrl->aformula = VSP_FORM_ALPHA0;
-		vsp_bru_ctrl->acoefx = VSP_COEFFICIENT_ALPHAX4;
-		vsp_bru_ctrl->acoefy = VSP_COEFFICIENT_ALPHAY5;
-		vsp_bru_ctrl->acoefx_fix = 0;    /* Set coefficient x. */
-		vsp_bru_ctrl->acoefy_fix = 0xFF; /* Set coefficient y. */
+		bru_set_blend(vsp_bru_ctrl, blend, coef, premultiplied);
 	}
-
-	return 0;
 }
 
 /* -----------------------------------------------------------------------------
@@ -447,6 +688,17 @@ static int bru_set_selection(struct v4l2_subdev *subdev,
 	sel->r.width = format->width;
 	sel->r.height = format->height;
 
+	/* The compose rectangles are read when building each job, changes
+	 * made while streaming go through the pipeline to be applied to the
+	 * right frame.
+	 */
+	if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE &&
+	    vsp2_entity_is_streaming(&bru->entity)) {
+		vsp2_pipeline_set_compose(to_vsp2_pipeline(&subdev->entity),
+					  bru, sel->pad, &sel->r);
+		return 0;
+	}
+
 	compose = bru_get_compose(bru, fh, sel->pad, sel->which);
 	*compose = sel->r;
 
@@ -483,6 +735,7 @@ struct vsp2_bru *vsp2_bru_create(struct vsp2_device *vsp2)
 {
 	struct v4l2_subdev *subdev;
 	struct vsp2_bru *bru;
+	unsigned int i;
 	int ret;
 
 	bru = devm_kzalloc(vsp2->dev, sizeof(*bru), GFP_KERNEL);
@@ -509,10 +762,75 @@ struct vsp2_bru *vsp2_bru_create(struct vsp2_device *vsp2)
 	vsp2_entity_init_formats(subdev, NULL);
 
 	/* Initialize the control handler. */
-	v4l2_ctrl_handler_init(&bru->ctrls, 1);
+	v4l2_ctrl_handler_init(&bru->ctrls, 21);
 	v4l2_ctrl_new_std(&bru->ctrls, &bru_ctrl_ops, V4L2_CID_BG_COLOR,
 			  0, 0xffffff, 1, 0);
 
+	for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+		struct v4l2_ctrl_config zorder = {
+			.ops = &bru_ctrl_ops,
+			.id = V4L2_CID_VSP2_BRU_ZORDER(i),
+			.name = bru_zorder_names[i],
+			.type = V4L2_CTRL_TYPE_INTEGER,
+			.min = 0,
+			.max = ARRAY_SIZE(bru->inputs) - 1,
+			.step = 1,
+			.def = i,
+		};
+
+		struct v4l2_ctrl_config enable = {
+			.ops = &bru_ctrl_ops,
+			.id = V4L2_CID_VSP2_BRU_ENABLE(i),
+			.name = bru_enable_names[i],
+			.type = V4L2_CTRL_TYPE_BOOLEAN,
+			.min = 0,
+			.max = 1,
+			.step = 1,
+			.def = 1,
+		};
+
+		struct v4l2_ctrl_config blend = {
+			.ops = &bru_ctrl_ops,
+			.id = V4L2_CID_VSP2_BRU_BLEND(i),
+			.name = bru_blend_names[i],
+			.type = V4L2_CTRL_TYPE_MENU,
+			.min = 0,
+			.max = VSP2_BRU_BLEND_CONSTANT,
+			.def = VSP2_BRU_BLEND_ALPHA,
+			.qmenu = bru_blend_menu,
+		};
+
+		struct v4l2_ctrl_config coef = {
+			.ops = &bru_ctrl_ops,
+			.id = V4L2_CID_VSP2_BRU_COEF(i),
+			.name = bru_coef_names[i],
+			.type = V4L2_CTRL_TYPE_INTEGER,
+			.min = 0,
+			.max = 255,
+			.step = 1,
+			.def = 255,
+		};
+
+		struct v4l2_ctrl_config rop = {
+			.ops = &bru_ctrl_ops,
+			.id = V4L2_CID_VSP2_BRU_ROP(i),
+			.name = bru_rop_names[i],
+			.type = V4L2_CTRL_TYPE_MENU,
+			.min = 0,
+			.max = VI6_ROP_SET,
+			.def = VI6_ROP_NOP,
+			.qmenu = bru_rop_menu,
+		};
+
+		v4l2_ctrl_new_custom(&bru->ctrls, &zorder, NULL);
+		v4l2_ctrl_new_custom(&bru->ctrls, &enable, NULL);
+		v4l2_ctrl_new_custom(&bru->ctrls, &blend, NULL);
+		v4l2_ctrl_new_custom(&bru->ctrls, &coef, NULL);
+		v4l2_ctrl_new_custom(&bru->ctrls, &rop, NULL);
+		bru->inputs[i].enabled = true;
+		bru->inputs[i].coef = 255;
+	}
+
 	bru->entity.subdev.ctrl_handler = &bru->ctrls;
 
 	if (bru->ctrls.error) {
@@ -69,6 +69,7 @@
 #include "vsp2_entity.h"
 
 struct vsp2_device;
+struct vsp2_pipeline_layer;
 struct vsp2_rwpf;
 
 #define BRU_PAD_SINK(n)				(n)
@@ -82,6 +83,11 @@ struct vsp2_bru {
 	struct {
 		struct vsp2_rwpf *rpf;
 		struct v4l2_rect compose;
+		unsigned int zorder;
+		bool enabled;
+		unsigned int blend;
+		unsigned int rop;
+		unsigned int coef;
 	} inputs[4];
 
 	u32 bgcolor;
@@ -94,4 +100,9 @@ static inline struct vsp2_bru *to_bru(struct v4l2_subdev *subdev)
 
 struct vsp2_bru *vsp2_bru_create(struct vsp2_device *vsp2);
 
+void vsp2_bru_configure(struct vsp2_bru *bru,
+			const struct vsp2_pipeline_layer *layers,
+			unsigned int num_layers, const struct v4l2_rect *window);
+void vsp2_bru_set_bgcolor(struct vsp2_bru *bru, u32 bgcolor);
+
 #endif /* __VSP2_BRU_H__ */
@@ -0,0 +1,435 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_clu.h"
+#include "vsp2_video.h"
+#include "vsp2_vspm.h"
+
+#define CLU_MIN_SIZE				1U
+#define CLU_MAX_SIZE				8190U
+
+/* -----------------------------------------------------------------------------
+ * Controls
+ */
+
+/*
+ * The table and update controls form a cluster, the table control being the
+ * master. When points are written to the update control they are applied to
+ * the new table value before the framework checks the cluster for changes.
+ * The table control is then updated and its listeners notified as if the
+ * table had been written.
+ */
+static int clu_try_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_clu *clu =
+		container_of(ctrl->handler, struct vsp2_clu, ctrls);
+	const u32 *points = clu->update->p_new.p_u32;
+	u32 *table = clu->table->p_new.p_u32;
+	unsigned int index;
+	unsigned int i;
+
+	if (!clu->update->is_new)
+		return 0;
+
+	for (i = 0; i < CLU_UPDATE_SIZE; ++i) {
+		if (points[i * 2] < CLU_SIZE &&
+		    points[i * 2 + 1] > 0x00ffffff)
+			return -ERANGE;
+	}
+
+	for (i = 0; i < CLU_UPDATE_SIZE; ++i) {
+		index = points[i * 2];
+		if (index < CLU_SIZE)
+			table[index] = points[i * 2 + 1];
+	}
+
+	return 0;
+}
+
+static int clu_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_clu *clu =
+		container_of(ctrl->handler, struct vsp2_clu, ctrls);
+	unsigned long flags;
+
+	spin_lock_irqsave(&clu->lock, flags);
+	memcpy(clu->shadow, clu->table->p_new.p_u32, sizeof(clu->shadow));
+	clu->dirty = true;
+	spin_unlock_irqrestore(&clu->lock, flags);
+
+	if (vsp2_entity_is_streaming(&clu->entity))
+		vsp2_pipeline_invalidate_job(
+			to_vsp2_pipeline(&clu->entity.subdev.entity));
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops clu_ctrl_ops = {
+	.try_ctrl = clu_try_ctrl,
+	.s_ctrl = clu_s_ctrl,
+};
+
+/*
+ * The table control holds the 17x17x17 cube of 0x00RRGGBB (or 0x00YYUUVV)
+ * output values, indexed by the input components sampled at 17 points, the
+ * first component varying slowest. The table can be modified while streaming,
+ * the new table is used starting at the next job.
+ */
+static const struct v4l2_ctrl_config clu_table_control = {
+	.ops = &clu_ctrl_ops,
+	.id = V4L2_CID_VSP2_CLU_TABLE,
+	.name = "Look-Up Table",
+	.type = V4L2_CTRL_TYPE_U32,
+	.min = 0x00000000,
+	.max = 0x00ffffff,
+	.step = 1,
+	.def = 0,
+	.dims = { CLU_DIM, CLU_DIM, CLU_DIM },
+};
+
+/*
+ * The update control modifies up to 64 table points without uploading the
+ * whole table. Each point is an (index, value) pair, with the index into the
+ * table control array. Pairs with an index out of the table are ignored. The
+ * points are applied on every write, even when the value is unchanged.
+ */
+static const struct v4l2_ctrl_config clu_update_control = {
+	.ops = &clu_ctrl_ops,
+	.id = V4L2_CID_VSP2_CLU_UPDATE,
+	.name = "Look-Up Table Update",
+	.type = V4L2_CTRL_TYPE_U32,
+	.min = 0x00000000,
+	.max = 0xffffffff,
+	.step = 1,
+	.def = 0xffffffff,
+	.dims = { CLU_UPDATE_SIZE, 2 },
+	.flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+};
+
+/* -----------------------------------------------------------------------------
+ * Job Configuration
+ */
+
+/*
+ * vsp2_clu_configure - Configure the CLU for the next job
+ * @clu: the CLU
+ *
+ * Copy the shadow table to the display list when it has been modified. The
+ * jobs are serialized, the display list isn't in use by the VSPM when the next
+ * job is configured.
+ */
+void vsp2_clu_configure(struct vsp2_clu *clu)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&clu->lock, flags);
+
+	if (clu->dirty) {
+		for (i = 0; i < CLU_SIZE; ++i)
+			clu->entries[i + 1].data = clu->shadow[i];
+
+		clu->dirty = false;
+	}
+
+	spin_unlock_irqrestore(&clu->lock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int clu_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_clu *clu = to_clu(subdev);
+	int ret;
+	VSPM_VSP_PAR *vsp_par =
+		clu->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_CLU *vsp_clu = vsp_par->ctrl_par->clu;
+
+	ret = vsp2_entity_set_streaming(&clu->entity, enable);
+	if (ret < 0)
+		return ret;
+
+	if (!enable)
+		return 0;
+
+	/* The table is updated by vsp2_clu_configure() for every job. */
+	vsp_clu->clu.hard_addr = (void *)(unsigned long)clu->dma;
+	vsp_clu->clu.virt_addr = clu->entries;
+	vsp_clu->clu.tbl_num = CLU_SIZE + 1;
+	vsp_clu->mode = VSP_CLU_MODE_3D;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Pad Operations
+ */
+
+static int clu_enum_mbus_code(struct v4l2_subdev *subdev,
+			      struct v4l2_subdev_fh *fh,
+			      struct v4l2_subdev_mbus_code_enum *code)
+{
+	static const unsigned int codes[] = {
+		V4L2_MBUS_FMT_ARGB8888_1X32,
+		V4L2_MBUS_FMT_AYUV8_1X32,
+	};
+	struct v4l2_mbus_framefmt *format;
+
+	if (code->pad == CLU_PAD_SINK) {
+		if (code->index >= ARRAY_SIZE(codes))
+			return -EINVAL;
+
+		code->code = codes[code->index];
+	} else {
+		/* The CLU can't perform format conversion, the sink format is
+		 * always identical to the source format.
+		 */
+		if (code->index)
+			return -EINVAL;
+
+		format = v4l2_subdev_get_try_format(fh, CLU_PAD_SINK);
+		code->code = format->code;
+	}
+
+	return 0;
+}
+
+static int clu_enum_frame_size(struct v4l2_subdev *subdev,
+			       struct v4l2_subdev_fh *fh,
+			       struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct v4l2_mbus_framefmt *format;
+
+	format = v4l2_subdev_get_try_format(fh, fse->pad);
+
+	if (fse->index || fse->code != format->code)
+		return -EINVAL;
+
+	if (fse->pad == CLU_PAD_SINK) {
+		fse->min_width = CLU_MIN_SIZE;
+		fse->max_width = CLU_MAX_SIZE;
+		fse->min_height = CLU_MIN_SIZE;
+		fse->max_height = CLU_MAX_SIZE;
+	} else {
+		/* The size on the source pad are fixed and always identical to
+		 * the size on the sink pad.
+		 */
+		fse->min_width = format->width;
+		fse->max_width = format->width;
+		fse->min_height = format->height;
+		fse->max_height = format->height;
+	}
+
+	return 0;
+}
+
+static int clu_get_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_clu *clu = to_clu(subdev);
+
+	fmt->format = *vsp2_entity_get_pad_format(&clu->entity, fh, fmt->pad,
+						  fmt->which);
+
+	return 0;
+}
+
+static int clu_set_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_clu *clu = to_clu(subdev);
+	struct v4l2_mbus_framefmt *format;
+
+	/* Default to YUV if the requested format is not supported. */
+	if (fmt->format.code != V4L2_MBUS_FMT_ARGB8888_1X32 &&
+	    fmt->format.code != V4L2_MBUS_FMT_AYUV8_1X32)
+		fmt->format.code = V4L2_MBUS_FMT_AYUV8_1X32;
+
+	format = vsp2_entity_get_pad_format(&clu->entity, fh, fmt->pad,
+					    fmt->which);
+
+	if (fmt->pad == CLU_PAD_SOURCE) {
+		/* The CLU output format can't be modified. */
+		fmt->format = *format;
+		return 0;
+	}
+
+	format->code = fmt->format.code;
+	format->width = clamp_t(unsigned int, fmt->format.width,
+				CLU_MIN_SIZE, CLU_MAX_SIZE);
+	format->height = clamp_t(unsigned int, fmt->format.height,
+				 CLU_MIN_SIZE, CLU_MAX_SIZE);
+	format->field = V4L2_FIELD_NONE;
+	format->colorspace = V4L2_COLORSPACE_SRGB;
+
+	fmt->format = *format;
+
+	/* Propagate the format to the source pad. */
+	format = vsp2_entity_get_pad_format(&clu->entity, fh, CLU_PAD_SOURCE,
+					    fmt->which);
+	*format = fmt->format;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops clu_video_ops = {
+	.s_stream = clu_s_stream,
+};
+
+static struct v4l2_subdev_pad_ops clu_pad_ops = {
+	.enum_mbus_code = clu_enum_mbus_code,
+	.enum_frame_size = clu_enum_frame_size,
+	.get_fmt = clu_get_format,
+	.set_fmt = clu_set_format,
+};
+
+static struct v4l2_subdev_ops clu_ops = {
+	.video	= &clu_video_ops,
+	.pad    = &clu_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_clu *vsp2_clu_create(struct vsp2_device *vsp2)
+{
+	struct v4l2_subdev *subdev;
+	struct vsp2_clu *clu;
+	unsigned int i;
+	size_t size;
+	int ret;
+
+	clu = devm_kzalloc(vsp2->dev, sizeof(*clu), GFP_KERNEL);
+	if (clu == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&clu->lock);
+
+	/* The display list resets the table address and then writes all
+	 * table entries through the auto-incremented data register.
+	 */
+	size = (CLU_SIZE + 1) * sizeof(*clu->entries);
+	clu->entries = dmam_alloc_coherent(vsp2->dev, size, &clu->dma,
+					   GFP_KERNEL);
+	if (clu->entries == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	clu->entries[0].addr = VI6_CLU_ADDR;
+	clu->entries[0].data = 0;
+
+	for (i = 1; i <= CLU_SIZE; ++i)
+		clu->entries[i].addr = VI6_CLU_DATA;
+
+	clu->entity.type = VSP2_ENTITY_CLU;
+
+	ret = vsp2_entity_init(vsp2, &clu->entity, 2);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the V4L2 subdev. */
+	subdev = &clu->entity.subdev;
+	v4l2_subdev_init(subdev, &clu_ops);
+
+	subdev->entity.ops = &vsp2_media_ops;
+	subdev->internal_ops = &vsp2_subdev_internal_ops;
+	snprintf(subdev->name, sizeof(subdev->name), "%s clu",
+		 dev_name(vsp2->dev));
+	v4l2_set_subdevdata(subdev, clu);
+	subdev->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	vsp2_entity_init_formats(subdev, NULL);
+
+	/* Initialize the control handler. The table control is set up when
+	 * the stream starts, which fills the display list.
+	 */
+	v4l2_ctrl_handler_init(&clu->ctrls, 2);
+	clu->table = v4l2_ctrl_new_custom(&clu->ctrls, &clu_table_control,
+					  NULL);
+	clu->update = v4l2_ctrl_new_custom(&clu->ctrls, &clu_update_control,
+					   NULL);
+
+	clu->entity.subdev.ctrl_handler = &clu->ctrls;
+
+	if (clu->ctrls.error) {
+		dev_err(vsp2->dev, "clu: failed to initialize controls\n");
+		ret = clu->ctrls.error;
+		vsp2_entity_destroy(&clu->entity);
+		return ERR_PTR(ret);
+	}
+
+	v4l2_ctrl_cluster(2, &clu->table);
+
+	return clu;
+}
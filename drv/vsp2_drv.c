@@ -70,7 +70,15 @@
 
 #include "vsp2.h"
 #include "vsp2_bru.h"
+#include "vsp2_clu.h"
+#include "vsp2_hgo.h"
+#include "vsp2_hgt.h"
+#include "vsp2_hsi.h"
+#include "vsp2_hst.h"
+#include "vsp2_lif.h"
+#include "vsp2_lut.h"
 #include "vsp2_rwpf.h"
+#include "vsp2_sru.h"
 #include "vsp2_uds.h"
 #include "vsp2_vspm.h"
 
@@ -109,6 +117,10 @@ void vsp2_frame_end(struct vsp2_device *vsp2)
  *
  * - from a UDS to a UDS (UDS entities can't be chained)
  * - from an entity to itself (no loops are allowed)
+ * - from the HGO and HGT (their output only feeds the histogram video nodes)
+ * - from the LIF (its output goes to the display)
+ * - between the WPF and any entity but the LIF (the WPF output goes to memory,
+ *   and to the display through the LIF)
  */
 static int vsp2_create_links(struct vsp2_device *vsp2, struct vsp2_entity *sink)
 {
@@ -123,7 +135,13 @@ static int vsp2_create_links(struct vsp2_device *vsp2, struct vsp2_entity *sink)
 		if (source->type == sink->type)
 			continue;
 
-		if (source->type == VSP2_ENTITY_WPF)
+		if (source->type == VSP2_ENTITY_HGO ||
+		    source->type == VSP2_ENTITY_HGT ||
+		    source->type == VSP2_ENTITY_LIF)
+			continue;
+
+		if ((source->type == VSP2_ENTITY_WPF) !=
+		    (sink->type == VSP2_ENTITY_LIF))
 			continue;
 
 		flags = source->type == VSP2_ENTITY_RPF &&
@@ -156,6 +174,9 @@ static void vsp2_destroy_entities(struct vsp2_device *vsp2)
 
 	list_for_each_entry_safe(entity, next, &vsp2->entities, list_dev) {
 		list_del(&entity->list_dev);
+		if (entity->type == VSP2_ENTITY_HGO ||
+		    entity->type == VSP2_ENTITY_HGT)
+			vsp2_histogram_cleanup(to_histogram(&entity->subdev));
 		vsp2_entity_destroy(entity);
 	}
 
@@ -199,6 +220,62 @@ static int vsp2_create_entities(struct vsp2_device *vsp2)
 
 	list_add_tail(&vsp2->bru->entity.list_dev, &vsp2->entities);
 
+	vsp2->clu = vsp2_clu_create(vsp2);
+	if (IS_ERR(vsp2->clu)) {
+		ret = PTR_ERR(vsp2->clu);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->clu->entity.list_dev, &vsp2->entities);
+
+	vsp2->hgo = vsp2_hgo_create(vsp2);
+	if (IS_ERR(vsp2->hgo)) {
+		ret = PTR_ERR(vsp2->hgo);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->hgo->histo.entity.list_dev, &vsp2->entities);
+
+	vsp2->hgt = vsp2_hgt_create(vsp2);
+	if (IS_ERR(vsp2->hgt)) {
+		ret = PTR_ERR(vsp2->hgt);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->hgt->histo.entity.list_dev, &vsp2->entities);
+
+	vsp2->hsi = vsp2_hsi_create(vsp2);
+	if (IS_ERR(vsp2->hsi)) {
+		ret = PTR_ERR(vsp2->hsi);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->hsi->entity.list_dev, &vsp2->entities);
+
+	vsp2->hst = vsp2_hst_create(vsp2);
+	if (IS_ERR(vsp2->hst)) {
+		ret = PTR_ERR(vsp2->hst);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->hst->entity.list_dev, &vsp2->entities);
+
+	vsp2->lif = vsp2_lif_create(vsp2);
+	if (IS_ERR(vsp2->lif)) {
+		ret = PTR_ERR(vsp2->lif);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->lif->entity.list_dev, &vsp2->entities);
+
+	vsp2->lut = vsp2_lut_create(vsp2);
+	if (IS_ERR(vsp2->lut)) {
+		ret = PTR_ERR(vsp2->lut);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->lut->entity.list_dev, &vsp2->entities);
+
 	for (i = 0; i < VSP2_COUNT_RPF; ++i) {
 		struct vsp2_rwpf *rpf;
 
@@ -212,6 +289,14 @@ static int vsp2_create_entities(struct vsp2_device *vsp2)
 		list_add_tail(&rpf->entity.list_dev, &vsp2->entities);
 	}
 
+	vsp2->sru = vsp2_sru_create(vsp2);
+	if (IS_ERR(vsp2->sru)) {
+		ret = PTR_ERR(vsp2->sru);
+		goto done;
+	}
+
+	list_add_tail(&vsp2->sru->entity.list_dev, &vsp2->entities);
+
 	for (i = 0; i < VSP2_COUNT_UDS; ++i) {
 		struct vsp2_uds *uds;
 
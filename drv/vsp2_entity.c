@@ -168,6 +168,47 @@ const struct v4l2_subdev_internal_ops vsp2_subdev_internal_ops = {
  * Media Operations
  */
 
+static bool vsp2_entity_is_histogram(struct media_entity *entity)
+{
+	struct vsp2_entity *e;
+
+	if (media_entity_type(entity) != MEDIA_ENT_T_V4L2_SUBDEV)
+		return false;
+
+	e = to_vsp2_entity(media_entity_to_v4l2_subdev(entity));
+
+	return e->type == VSP2_ENTITY_HGO || e->type == VSP2_ENTITY_HGT;
+}
+
+/*
+ * vsp2_entity_remote_pad - Find the remote pad in the data path
+ * @pad: local pad
+ *
+ * Return the pad connected to @pad through an enabled link, or NULL if no such
+ * link exists. Links to the HGO and HGT sink pads are ignored as the histogram
+ * entities don't belong to the data path.
+ */
+struct media_pad *vsp2_entity_remote_pad(struct media_pad *pad)
+{
+	unsigned int i;
+
+	for (i = 0; i < pad->entity->num_links; i++) {
+		struct media_link *link = &pad->entity->links[i];
+
+		if (!(link->flags & MEDIA_LNK_FL_ENABLED))
+			continue;
+
+		if (link->source == pad &&
+		    !vsp2_entity_is_histogram(link->sink->entity))
+			return link->sink;
+
+		if (link->sink == pad)
+			return link->source;
+	}
+
+	return NULL;
+}
+
 static int vsp2_entity_link_setup(struct media_entity *entity,
 				  const struct media_pad *local,
 				  const struct media_pad *remote, u32 flags)
@@ -182,6 +223,18 @@ static int vsp2_entity_link_setup(struct media_entity *entity,
 	if (!source->route)
 		return 0;
 
+	/* The WPF sink is always its video node. The link to the LIF selects
+	 * the display output and doesn't replace it.
+	 */
+	if (source->type == VSP2_ENTITY_WPF)
+		return 0;
+
+	/* The HGO and HGT sample the data path without being part of it,
+	 * links to their sink pad don't count in the output fan-out.
+	 */
+	if (vsp2_entity_is_histogram(remote->entity))
+		return 0;
+
 	if (flags & MEDIA_LNK_FL_ENABLED) {
 		if (source->sink)
 			return -EBUSY;
@@ -207,13 +260,32 @@ const struct media_entity_operations vsp2_media_ops = {
 static const struct vsp2_route vsp2_routes[] = {
 	{ VSP2_ENTITY_BRU, 0, VI6_DPR_BRU_ROUTE,
 	  { VI6_DPR_NODE_BRU_IN(0), VI6_DPR_NODE_BRU_IN(1),
-	    VI6_DPR_NODE_BRU_IN(2), VI6_DPR_NODE_BRU_IN(3), } },
-	{ VSP2_ENTITY_RPF, 0, VI6_DPR_RPF_ROUTE(0), { VI6_DPR_NODE_RPF(0), } },
-	{ VSP2_ENTITY_RPF, 1, VI6_DPR_RPF_ROUTE(1), { VI6_DPR_NODE_RPF(1), } },
-	{ VSP2_ENTITY_RPF, 2, VI6_DPR_RPF_ROUTE(2), { VI6_DPR_NODE_RPF(2), } },
-	{ VSP2_ENTITY_RPF, 3, VI6_DPR_RPF_ROUTE(3), { VI6_DPR_NODE_RPF(3), } },
-	{ VSP2_ENTITY_UDS, 0, VI6_DPR_UDS_ROUTE(0), { VI6_DPR_NODE_UDS(0), } },
-	{ VSP2_ENTITY_WPF, 0, 0, { VI6_DPR_NODE_WPF(0), } },
+	    VI6_DPR_NODE_BRU_IN(2), VI6_DPR_NODE_BRU_IN(3), },
+	  VI6_DPR_NODE_BRU_OUT },
+	{ VSP2_ENTITY_CLU, 0, VI6_DPR_CLU_ROUTE, { VI6_DPR_NODE_CLU, },
+	  VI6_DPR_NODE_CLU },
+	{ VSP2_ENTITY_HGO, 0, 0, { 0, }, 0 },
+	{ VSP2_ENTITY_HGT, 0, 0, { 0, }, 0 },
+	{ VSP2_ENTITY_HSI, 0, VI6_DPR_HSI_ROUTE, { VI6_DPR_NODE_HSI, },
+	  VI6_DPR_NODE_HSI },
+	{ VSP2_ENTITY_HST, 0, VI6_DPR_HST_ROUTE, { VI6_DPR_NODE_HST, },
+	  VI6_DPR_NODE_HST },
+	{ VSP2_ENTITY_LIF, 0, 0, { VI6_DPR_NODE_LIF, }, 0 },
+	{ VSP2_ENTITY_LUT, 0, VI6_DPR_LUT_ROUTE, { VI6_DPR_NODE_LUT, },
+	  VI6_DPR_NODE_LUT },
+	{ VSP2_ENTITY_RPF, 0, VI6_DPR_RPF_ROUTE(0), { VI6_DPR_NODE_RPF(0), },
+	  VI6_DPR_NODE_RPF(0) },
+	{ VSP2_ENTITY_RPF, 1, VI6_DPR_RPF_ROUTE(1), { VI6_DPR_NODE_RPF(1), },
+	  VI6_DPR_NODE_RPF(1) },
+	{ VSP2_ENTITY_RPF, 2, VI6_DPR_RPF_ROUTE(2), { VI6_DPR_NODE_RPF(2), },
+	  VI6_DPR_NODE_RPF(2) },
+	{ VSP2_ENTITY_RPF, 3, VI6_DPR_RPF_ROUTE(3), { VI6_DPR_NODE_RPF(3), },
+	  VI6_DPR_NODE_RPF(3) },
+	{ VSP2_ENTITY_SRU, 0, VI6_DPR_SRU_ROUTE, { VI6_DPR_NODE_SRU, },
+	  VI6_DPR_NODE_SRU },
+	{ VSP2_ENTITY_UDS, 0, VI6_DPR_UDS_ROUTE(0), { VI6_DPR_NODE_UDS(0), },
+	  VI6_DPR_NODE_UDS(0) },
+	{ VSP2_ENTITY_WPF, 0, 0, { VI6_DPR_NODE_WPF(0), }, 0 },
 };
 
 int vsp2_entity_init(struct vsp2_device *vsp2, struct vsp2_entity *entity,
@@ -72,7 +72,15 @@ struct vsp2_video;
 
 enum vsp2_entity_type {
 	VSP2_ENTITY_BRU,
+	VSP2_ENTITY_CLU,
+	VSP2_ENTITY_HGO,
+	VSP2_ENTITY_HGT,
+	VSP2_ENTITY_HSI,
+	VSP2_ENTITY_HST,
+	VSP2_ENTITY_LIF,
+	VSP2_ENTITY_LUT,
 	VSP2_ENTITY_RPF,
+	VSP2_ENTITY_SRU,
 	VSP2_ENTITY_UDS,
 	VSP2_ENTITY_WPF,
 };
@@ -83,17 +91,20 @@ enum vsp2_entity_type {
  * @index: Entity index this routing entry is associated with
  * @reg: Output routing configuration register
  * @inputs: Target node value for each input
+ * @output: Target node value for the entity output
  *
  * Each $vsp2_route entry describes routing configuration for the entity
  * specified by the entry's @type and @index. @reg indicates the register that
  * holds output routing configuration for the entity, and the @inputs array
- * store the target node value for each input of the entity.
+ * store the target node value for each input of the entity. The @output node
+ * value selects the entity output as a histogram sampling point.
  */
 struct vsp2_route {
 	enum vsp2_entity_type type;
 	unsigned int index;
 	unsigned int reg;
 	unsigned int inputs[4];
+	unsigned int output;
 };
 
 struct vsp2_entity {
@@ -140,6 +151,8 @@ vsp2_entity_get_pad_format(struct vsp2_entity *entity,
 void vsp2_entity_init_formats(struct v4l2_subdev *subdev,
 			      struct v4l2_subdev_fh *fh);
 
+struct media_pad *vsp2_entity_remote_pad(struct media_pad *pad);
+
 bool vsp2_entity_is_streaming(struct vsp2_entity *entity);
 int vsp2_entity_set_streaming(struct vsp2_entity *entity, bool streaming);
 
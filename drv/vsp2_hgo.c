@@ -0,0 +1,224 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_hgo.h"
+#include "vsp2_video.h"
+#include "vsp2_vspm.h"
+
+/* -----------------------------------------------------------------------------
+ * Controls
+ */
+
+static int hgo_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_hgo *hgo =
+		container_of(ctrl->handler, struct vsp2_hgo, ctrls);
+	struct vsp2_entity *entity = &hgo->histo.entity;
+	unsigned long flags;
+
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_HGO_MAX_RGB:
+		spin_lock_irqsave(&hgo->lock, flags);
+		hgo->max_rgb = ctrl->val;
+		spin_unlock_irqrestore(&hgo->lock, flags);
+		break;
+	}
+
+	if (vsp2_entity_is_streaming(entity))
+		vsp2_pipeline_invalidate_job(
+			to_vsp2_pipeline(&entity->subdev.entity));
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops hgo_ctrl_ops = {
+	.s_ctrl = hgo_s_ctrl,
+};
+
+/*
+ * In max RGB mode the histogram of the largest of the three components of
+ * each pixel is computed in the first (R) component histogram.
+ */
+static const struct v4l2_ctrl_config hgo_max_rgb_control = {
+	.ops = &hgo_ctrl_ops,
+	.id = V4L2_CID_VSP2_HGO_MAX_RGB,
+	.name = "Max RGB Mode",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.min = 0,
+	.max = 1,
+	.step = 1,
+	.def = 0,
+};
+
+/* -----------------------------------------------------------------------------
+ * Job Configuration
+ */
+
+/*
+ * vsp2_hgo_configure - Configure the HGO for the next job
+ * @hgo: the HGO
+ *
+ * The max RGB mode is programmed for every job, a mode change thus takes
+ * effect at the next job.
+ */
+void vsp2_hgo_configure(struct vsp2_hgo *hgo)
+{
+	VSPM_VSP_PAR *vsp_par =
+		hgo->histo.entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_HGO *vsp_hgo = vsp_par->ctrl_par->hgo;
+	unsigned long flags;
+
+	spin_lock_irqsave(&hgo->lock, flags);
+	vsp_hgo->maxrgb_mode = hgo->max_rgb ? VSP_MAXRGB_ON : VSP_MAXRGB_OFF;
+	spin_unlock_irqrestore(&hgo->lock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int hgo_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_hgo *hgo = to_hgo(subdev);
+	struct vsp2_entity *entity = &hgo->histo.entity;
+	VSPM_VSP_PAR *vsp_par = entity->vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_HGO *vsp_hgo = vsp_par->ctrl_par->hgo;
+	const struct v4l2_mbus_framefmt *format;
+	int sampling;
+
+	if (enable) {
+		sampling = vsp2_histogram_sampling(&hgo->histo);
+		if (sampling < 0)
+			return sampling;
+
+		format = &entity->formats[HISTO_PAD_SINK];
+
+		vsp_par->use_module |= VSP_HGO_USE;
+
+		vsp_hgo->hard_addr = (void *)(unsigned long)hgo->histo.dma;
+		vsp_hgo->virt_addr = hgo->histo.data;
+		vsp_hgo->width = format->width;
+		vsp_hgo->height = format->height;
+		vsp_hgo->x_offset = 0;
+		vsp_hgo->y_offset = 0;
+		vsp_hgo->sampling = sampling;
+	}
+
+	return vsp2_entity_set_streaming(entity, enable);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops hgo_video_ops = {
+	.s_stream = hgo_s_stream,
+};
+
+static struct v4l2_subdev_ops hgo_ops = {
+	.video	= &hgo_video_ops,
+	.pad    = &vsp2_histogram_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_hgo *vsp2_hgo_create(struct vsp2_device *vsp2)
+{
+	struct vsp2_hgo *hgo;
+	int ret;
+
+	hgo = devm_kzalloc(vsp2->dev, sizeof(*hgo), GFP_KERNEL);
+	if (hgo == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&hgo->lock);
+
+	hgo->histo.entity.type = VSP2_ENTITY_HGO;
+
+	ret = vsp2_histogram_init(vsp2, &hgo->histo, "hgo", &hgo_ops,
+				  V4L2_PIX_FMT_VSP2_HGO, HGO_DATA_SIZE);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the control handler. */
+	v4l2_ctrl_handler_init(&hgo->ctrls, 1);
+	v4l2_ctrl_new_custom(&hgo->ctrls, &hgo_max_rgb_control, NULL);
+
+	hgo->histo.entity.subdev.ctrl_handler = &hgo->ctrls;
+
+	if (hgo->ctrls.error) {
+		dev_err(vsp2->dev, "hgo: failed to initialize controls\n");
+		ret = hgo->ctrls.error;
+		vsp2_histogram_cleanup(&hgo->histo);
+		vsp2_entity_destroy(&hgo->histo.entity);
+		return ERR_PTR(ret);
+	}
+
+	return hgo;
+}
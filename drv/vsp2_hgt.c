@@ -0,0 +1,280 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_hgt.h"
+#include "vsp2_video.h"
+#include "vsp2_vspm.h"
+
+/* -----------------------------------------------------------------------------
+ * Controls
+ */
+
+static int hgt_try_ctrl(struct v4l2_ctrl *ctrl)
+{
+	const u8 *values = ctrl->p_new.p_u8;
+	unsigned int wraps = 0;
+	unsigned int i;
+
+	/* The hue area boundaries must be ordered in one of the two following
+	 * ways, the second one describing an area 0 that wraps around the hue
+	 * circle.
+	 *
+	 * 0L <= 0U <= 1L <= 1U <= ... <= 5L <= 5U
+	 * 0U <= 1L <= 1U <= ... <= 5L <= 5U <= 0L
+	 *
+	 * Walking the boundaries circularly, at most one value can thus be
+	 * smaller than its predecessor, and only around 0L.
+	 */
+	for (i = 0; i < HGT_NUM_HUE_AREAS * 2; ++i) {
+		unsigned int next = (i + 1) % (HGT_NUM_HUE_AREAS * 2);
+
+		if (values[next] >= values[i])
+			continue;
+
+		if (i != 0 && next != 0)
+			return -EINVAL;
+
+		wraps++;
+	}
+
+	return wraps > 1 ? -EINVAL : 0;
+}
+
+static int hgt_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_hgt *hgt =
+		container_of(ctrl->handler, struct vsp2_hgt, ctrls);
+	struct vsp2_entity *entity = &hgt->histo.entity;
+	unsigned long flags;
+
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_HGT_HUE_AREAS:
+		spin_lock_irqsave(&hgt->lock, flags);
+		memcpy(hgt->hue_areas, ctrl->p_new.p_u8,
+		       sizeof(hgt->hue_areas));
+		spin_unlock_irqrestore(&hgt->lock, flags);
+		break;
+	}
+
+	if (vsp2_entity_is_streaming(entity))
+		vsp2_pipeline_invalidate_job(
+			to_vsp2_pipeline(&entity->subdev.entity));
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops hgt_ctrl_ops = {
+	.try_ctrl = hgt_try_ctrl,
+	.s_ctrl = hgt_s_ctrl,
+};
+
+/*
+ * The hue areas control holds the lower and upper boundaries of the six hue
+ * areas, in that order. The histogram counts the pixels of each hue area in
+ * 32 saturation bins. The HGT interprets its input as HSV data, it must sample
+ * the data path after a conversion to HSV, pipelines where it doesn't are
+ * rejected when the stream starts.
+ */
+static const struct v4l2_ctrl_config hgt_hue_areas_control = {
+	.ops = &hgt_ctrl_ops,
+	.id = V4L2_CID_VSP2_HGT_HUE_AREAS,
+	.name = "Hue Areas",
+	.type = V4L2_CTRL_TYPE_U8,
+	.min = 0,
+	.max = 255,
+	.step = 1,
+	.def = 0,
+	.dims = { HGT_NUM_HUE_AREAS * 2 },
+};
+
+/* -----------------------------------------------------------------------------
+ * Job Configuration
+ */
+
+/*
+ * vsp2_hgt_configure - Configure the HGT for the next job
+ * @hgt: the HGT
+ *
+ * The hue areas are programmed for every job, changes thus take effect at the
+ * next job.
+ */
+void vsp2_hgt_configure(struct vsp2_hgt *hgt)
+{
+	VSPM_VSP_PAR *vsp_par =
+		hgt->histo.entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_HGT *vsp_hgt = vsp_par->ctrl_par->hgt;
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&hgt->lock, flags);
+
+	for (i = 0; i < HGT_NUM_HUE_AREAS; ++i) {
+		vsp_hgt->area[i].lower = hgt->hue_areas[i * 2];
+		vsp_hgt->area[i].upper = hgt->hue_areas[i * 2 + 1];
+	}
+
+	spin_unlock_irqrestore(&hgt->lock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int hgt_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_hgt *hgt = to_hgt(subdev);
+	struct vsp2_entity *entity = &hgt->histo.entity;
+	VSPM_VSP_PAR *vsp_par = entity->vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_HGT *vsp_hgt = vsp_par->ctrl_par->hgt;
+	const struct v4l2_mbus_framefmt *format;
+	int sampling;
+
+	if (enable) {
+		sampling = vsp2_histogram_sampling(&hgt->histo);
+		if (sampling < 0)
+			return sampling;
+
+		format = &entity->formats[HISTO_PAD_SINK];
+
+		vsp_par->use_module |= VSP_HGT_USE;
+
+		vsp_hgt->hard_addr = (void *)(unsigned long)hgt->histo.dma;
+		vsp_hgt->virt_addr = hgt->histo.data;
+		vsp_hgt->width = format->width;
+		vsp_hgt->height = format->height;
+		vsp_hgt->x_offset = 0;
+		vsp_hgt->y_offset = 0;
+		vsp_hgt->sampling = sampling;
+	}
+
+	return vsp2_entity_set_streaming(entity, enable);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops hgt_video_ops = {
+	.s_stream = hgt_s_stream,
+};
+
+static struct v4l2_subdev_ops hgt_ops = {
+	.video	= &hgt_video_ops,
+	.pad    = &vsp2_histogram_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_hgt *vsp2_hgt_create(struct vsp2_device *vsp2)
+{
+	struct v4l2_ctrl *ctrl;
+	struct vsp2_hgt *hgt;
+	unsigned int i;
+	int ret;
+
+	hgt = devm_kzalloc(vsp2->dev, sizeof(*hgt), GFP_KERNEL);
+	if (hgt == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&hgt->lock);
+
+	hgt->histo.entity.type = VSP2_ENTITY_HGT;
+
+	ret = vsp2_histogram_init(vsp2, &hgt->histo, "hgt", &hgt_ops,
+				  V4L2_PIX_FMT_VSP2_HGT, HGT_DATA_SIZE);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the control handler. */
+	v4l2_ctrl_handler_init(&hgt->ctrls, 1);
+	ctrl = v4l2_ctrl_new_custom(&hgt->ctrls, &hgt_hue_areas_control, NULL);
+
+	hgt->histo.entity.subdev.ctrl_handler = &hgt->ctrls;
+
+	if (hgt->ctrls.error) {
+		dev_err(vsp2->dev, "hgt: failed to initialize controls\n");
+		ret = hgt->ctrls.error;
+		vsp2_histogram_cleanup(&hgt->histo);
+		vsp2_entity_destroy(&hgt->histo.entity);
+		return ERR_PTR(ret);
+	}
+
+	/* Split the hue circle in six areas of equal size by default. */
+	for (i = 0; i < HGT_NUM_HUE_AREAS; ++i) {
+		u8 lower = i * 256 / HGT_NUM_HUE_AREAS;
+		u8 upper = (i + 1) * 256 / HGT_NUM_HUE_AREAS - 1;
+
+		ctrl->p_cur.p_u8[i * 2] = lower;
+		ctrl->p_cur.p_u8[i * 2 + 1] = upper;
+	}
+
+	memcpy(ctrl->p_new.p_u8, ctrl->p_cur.p_u8, ctrl->elems);
+
+	return hgt;
+}
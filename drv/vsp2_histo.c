@@ -0,0 +1,550 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/gfp.h>
+#include <linux/videodev2.h>
+
+#include <media/v4l2-fh.h>
+#include <media/v4l2-ioctl.h>
+#include <media/v4l2-subdev.h>
+#include <media/videobuf2-vmalloc.h>
+
+#include "vsp2.h"
+#include "vsp2_histo.h"
+#include "vsp2_rwpf.h"
+#include "vsp2_video.h"
+
+#define HISTO_MIN_SIZE				1U
+#define HISTO_MAX_SIZE				8190U
+
+/* -----------------------------------------------------------------------------
+ * Histogram Delivery
+ */
+
+/*
+ * vsp2_histogram_sampling - Compute the sampling point register value
+ * @histo: the histogram entity
+ *
+ * The sampling point is the output of the entity the histogram sink pad is
+ * linked to, in the pipeline of the output WPF.
+ *
+ * Return the VI6_DPR_HGO_SMPPT or VI6_DPR_HGT_SMPPT value, or -EPIPE if the
+ * sink pad isn't linked.
+ */
+int vsp2_histogram_sampling(struct vsp2_histogram *histo)
+{
+	struct vsp2_pipeline *pipe =
+		to_vsp2_pipeline(&histo->entity.subdev.entity);
+	struct vsp2_entity *source;
+	struct media_pad *pad;
+
+	pad = media_entity_remote_pad(&histo->entity.pads[HISTO_PAD_SINK]);
+	if (pad == NULL ||
+	    media_entity_type(pad->entity) != MEDIA_ENT_T_V4L2_SUBDEV)
+		return -EPIPE;
+
+	source = to_vsp2_entity(media_entity_to_v4l2_subdev(pad->entity));
+
+	return (pipe->output->entity.index << VI6_DPR_SMPPT_TGW_SHIFT)
+	     | (source->route->output << VI6_DPR_SMPPT_PT_SHIFT);
+}
+
+/*
+ * vsp2_histogram_frame_end - Deliver the histogram of the completed frame
+ * @histo: the histogram entity
+ * @sequence: sequence number of the WPF output buffer
+ * @timestamp: timestamp of the WPF output buffer
+ *
+ * Copy the histogram computed by the last job to the first queued buffer and
+ * complete it with the sequence number and timestamp of the output buffer the
+ * histogram belongs to. The histogram is dropped if no buffer is queued.
+ */
+void vsp2_histogram_frame_end(struct vsp2_histogram *histo, u32 sequence,
+			      const struct timeval *timestamp)
+{
+	struct vsp2_histogram_buffer *buf;
+	unsigned long flags;
+
+	spin_lock_irqsave(&histo->irqlock, flags);
+	buf = list_first_entry_or_null(&histo->irqqueue,
+				       struct vsp2_histogram_buffer, queue);
+	if (buf)
+		list_del(&buf->queue);
+	spin_unlock_irqrestore(&histo->irqlock, flags);
+
+	if (buf == NULL)
+		return;
+
+	memcpy(vb2_plane_vaddr(&buf->buf, 0), histo->data, histo->data_size);
+
+	buf->buf.v4l2_buf.sequence = sequence;
+	buf->buf.v4l2_buf.timestamp = *timestamp;
+
+	vb2_set_plane_payload(&buf->buf, 0, histo->data_size);
+	vb2_buffer_done(&buf->buf, VB2_BUF_STATE_DONE);
+}
+
+/* -----------------------------------------------------------------------------
+ * videobuf2 Queue Operations
+ */
+
+static int
+histo_queue_setup(struct vb2_queue *vq, const struct v4l2_format *fmt,
+		  unsigned int *nbuffers, unsigned int *nplanes,
+		  unsigned int sizes[], void *alloc_ctxs[])
+{
+	struct vsp2_histogram *histo = vb2_get_drv_priv(vq);
+
+	if (fmt && fmt->fmt.pix.sizeimage < histo->data_size)
+		return -EINVAL;
+
+	*nplanes = 1;
+	sizes[0] = fmt ? fmt->fmt.pix.sizeimage : histo->data_size;
+
+	return 0;
+}
+
+static int histo_buffer_prepare(struct vb2_buffer *vb)
+{
+	struct vsp2_histogram *histo = vb2_get_drv_priv(vb->vb2_queue);
+
+	if (vb->num_planes != 1)
+		return -EINVAL;
+
+	if (vb2_plane_size(vb, 0) < histo->data_size)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void histo_buffer_queue(struct vb2_buffer *vb)
+{
+	struct vsp2_histogram *histo = vb2_get_drv_priv(vb->vb2_queue);
+	struct vsp2_histogram_buffer *buf = to_vsp2_histogram_buffer(vb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&histo->irqlock, flags);
+	list_add_tail(&buf->queue, &histo->irqqueue);
+	spin_unlock_irqrestore(&histo->irqlock, flags);
+}
+
+static int histo_stop_streaming(struct vb2_queue *vq)
+{
+	struct vsp2_histogram *histo = vb2_get_drv_priv(vq);
+	struct vsp2_histogram_buffer *buffer;
+	unsigned long flags;
+
+	/* Remove all buffers from the IRQ queue. */
+	spin_lock_irqsave(&histo->irqlock, flags);
+	list_for_each_entry(buffer, &histo->irqqueue, queue)
+		vb2_buffer_done(&buffer->buf, VB2_BUF_STATE_ERROR);
+	INIT_LIST_HEAD(&histo->irqqueue);
+	spin_unlock_irqrestore(&histo->irqlock, flags);
+
+	return 0;
+}
+
+static struct vb2_ops histo_queue_qops = {
+	.queue_setup = histo_queue_setup,
+	.buf_prepare = histo_buffer_prepare,
+	.buf_queue = histo_buffer_queue,
+	.wait_prepare = vb2_ops_wait_prepare,
+	.wait_finish = vb2_ops_wait_finish,
+	.stop_streaming = histo_stop_streaming,
+};
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Pad Operations
+ */
+
+static int histo_enum_mbus_code(struct v4l2_subdev *subdev,
+				struct v4l2_subdev_fh *fh,
+				struct v4l2_subdev_mbus_code_enum *code)
+{
+	static const unsigned int codes[] = {
+		V4L2_MBUS_FMT_ARGB8888_1X32,
+		V4L2_MBUS_FMT_AYUV8_1X32,
+	};
+	struct v4l2_mbus_framefmt *format;
+
+	if (code->pad == HISTO_PAD_SINK) {
+		if (code->index >= ARRAY_SIZE(codes))
+			return -EINVAL;
+
+		code->code = codes[code->index];
+	} else {
+		/* The source pad only feeds the histogram video node, its
+		 * format mirrors the sink format.
+		 */
+		if (code->index)
+			return -EINVAL;
+
+		format = v4l2_subdev_get_try_format(fh, HISTO_PAD_SINK);
+		code->code = format->code;
+	}
+
+	return 0;
+}
+
+static int histo_enum_frame_size(struct v4l2_subdev *subdev,
+				 struct v4l2_subdev_fh *fh,
+				 struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct v4l2_mbus_framefmt *format;
+
+	format = v4l2_subdev_get_try_format(fh, fse->pad);
+
+	if (fse->index || fse->code != format->code)
+		return -EINVAL;
+
+	if (fse->pad == HISTO_PAD_SINK) {
+		fse->min_width = HISTO_MIN_SIZE;
+		fse->max_width = HISTO_MAX_SIZE;
+		fse->min_height = HISTO_MIN_SIZE;
+		fse->max_height = HISTO_MAX_SIZE;
+	} else {
+		fse->min_width = format->width;
+		fse->max_width = format->width;
+		fse->min_height = format->height;
+		fse->max_height = format->height;
+	}
+
+	return 0;
+}
+
+static int histo_get_format(struct v4l2_subdev *subdev,
+			    struct v4l2_subdev_fh *fh,
+			    struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_histogram *histo = to_histogram(subdev);
+
+	fmt->format = *vsp2_entity_get_pad_format(&histo->entity, fh, fmt->pad,
+						  fmt->which);
+
+	return 0;
+}
+
+static int histo_set_format(struct v4l2_subdev *subdev,
+			    struct v4l2_subdev_fh *fh,
+			    struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_histogram *histo = to_histogram(subdev);
+	struct v4l2_mbus_framefmt *format;
+
+	/* Default to YUV if the requested format is not supported. */
+	if (fmt->format.code != V4L2_MBUS_FMT_ARGB8888_1X32 &&
+	    fmt->format.code != V4L2_MBUS_FMT_AYUV8_1X32)
+		fmt->format.code = V4L2_MBUS_FMT_AYUV8_1X32;
+
+	format = vsp2_entity_get_pad_format(&histo->entity, fh, fmt->pad,
+					    fmt->which);
+
+	if (fmt->pad == HISTO_PAD_SOURCE) {
+		fmt->format = *format;
+		return 0;
+	}
+
+	format->code = fmt->format.code;
+	format->width = clamp_t(unsigned int, fmt->format.width,
+				HISTO_MIN_SIZE, HISTO_MAX_SIZE);
+	format->height = clamp_t(unsigned int, fmt->format.height,
+				 HISTO_MIN_SIZE, HISTO_MAX_SIZE);
+	format->field = V4L2_FIELD_NONE;
+	format->colorspace = V4L2_COLORSPACE_SRGB;
+
+	fmt->format = *format;
+
+	/* Propagate the format to the source pad. */
+	format = vsp2_entity_get_pad_format(&histo->entity, fh,
+					    HISTO_PAD_SOURCE, fmt->which);
+	*format = fmt->format;
+
+	return 0;
+}
+
+const struct v4l2_subdev_pad_ops vsp2_histogram_pad_ops = {
+	.enum_mbus_code = histo_enum_mbus_code,
+	.enum_frame_size = histo_enum_frame_size,
+	.get_fmt = histo_get_format,
+	.set_fmt = histo_set_format,
+};
+
+/* -----------------------------------------------------------------------------
+ * V4L2 ioctls
+ */
+
+static int
+histo_querycap(struct file *file, void *fh, struct v4l2_capability *cap)
+{
+	struct vsp2_histogram *histo = video_drvdata(file);
+
+	cap->capabilities = V4L2_CAP_DEVICE_CAPS | V4L2_CAP_STREAMING
+			  | V4L2_CAP_VIDEO_CAPTURE_MPLANE
+			  | V4L2_CAP_VIDEO_OUTPUT_MPLANE
+			  | V4L2_CAP_VIDEO_CAPTURE;
+	cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+
+	strlcpy(cap->driver, "vsp2", sizeof(cap->driver));
+	strlcpy(cap->card, histo->video.name, sizeof(cap->card));
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s",
+		 dev_name(histo->entity.vsp2->dev));
+
+	return 0;
+}
+
+static int
+histo_enum_format(struct file *file, void *fh, struct v4l2_fmtdesc *f)
+{
+	struct vsp2_histogram *histo = video_drvdata(file);
+
+	if (f->index)
+		return -EINVAL;
+
+	f->pixelformat = histo->pixelformat;
+	strlcpy(f->description, "VSP2 histogram", sizeof(f->description));
+
+	return 0;
+}
+
+/* The histogram format is fixed, all format ioctls return it unmodified. */
+static int
+histo_get_format_vid(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct vsp2_histogram *histo = video_drvdata(file);
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+
+	memset(pix, 0, sizeof(*pix));
+	pix->width = histo->data_size;
+	pix->height = 1;
+	pix->pixelformat = histo->pixelformat;
+	pix->field = V4L2_FIELD_NONE;
+	pix->bytesperline = histo->data_size;
+	pix->sizeimage = histo->data_size;
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops histo_ioctl_ops = {
+	.vidioc_querycap		= histo_querycap,
+	.vidioc_enum_fmt_vid_cap	= histo_enum_format,
+	.vidioc_g_fmt_vid_cap		= histo_get_format_vid,
+	.vidioc_s_fmt_vid_cap		= histo_get_format_vid,
+	.vidioc_try_fmt_vid_cap		= histo_get_format_vid,
+	.vidioc_reqbufs			= vb2_ioctl_reqbufs,
+	.vidioc_querybuf		= vb2_ioctl_querybuf,
+	.vidioc_qbuf			= vb2_ioctl_qbuf,
+	.vidioc_dqbuf			= vb2_ioctl_dqbuf,
+	.vidioc_create_bufs		= vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf		= vb2_ioctl_prepare_buf,
+	.vidioc_streamon		= vb2_ioctl_streamon,
+	.vidioc_streamoff		= vb2_ioctl_streamoff,
+};
+
+/* -----------------------------------------------------------------------------
+ * V4L2 File Operations
+ */
+
+static struct v4l2_file_operations histo_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = video_ioctl2,
+	.open = v4l2_fh_open,
+	.release = vb2_fop_release,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+static int vsp2_histogram_init_video(struct vsp2_histogram *histo)
+{
+	struct vsp2_device *vsp2 = histo->entity.vsp2;
+	int ret;
+
+	mutex_init(&histo->lock);
+	spin_lock_init(&histo->irqlock);
+	INIT_LIST_HEAD(&histo->irqqueue);
+
+	/* Initialize the media entity... */
+	histo->pad.flags = MEDIA_PAD_FL_SINK;
+	ret = media_entity_init(&histo->video.entity, 1, &histo->pad, 0);
+	if (ret < 0)
+		return ret;
+
+	/* ... and the video node... */
+	histo->video.v4l2_dev = &vsp2->v4l2_dev;
+	histo->video.fops = &histo_fops;
+	snprintf(histo->video.name, sizeof(histo->video.name), "%s histo",
+		 histo->entity.subdev.name);
+	histo->video.vfl_type = VFL_TYPE_GRABBER;
+	histo->video.release = video_device_release_empty;
+	histo->video.ioctl_ops = &histo_ioctl_ops;
+
+	video_set_drvdata(&histo->video, histo);
+
+	/* ... and the buffers queue... */
+	histo->queue.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	histo->queue.io_modes = VB2_MMAP | VB2_USERPTR;
+	histo->queue.lock = &histo->lock;
+	histo->queue.drv_priv = histo;
+	histo->queue.buf_struct_size = sizeof(struct vsp2_histogram_buffer);
+	histo->queue.ops = &histo_queue_qops;
+	histo->queue.mem_ops = &vb2_vmalloc_memops;
+	histo->queue.timestamp_type = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	ret = vb2_queue_init(&histo->queue);
+	if (ret < 0) {
+		dev_err(vsp2->dev, "failed to initialize vb2 queue\n");
+		return ret;
+	}
+
+	/* ... and register the video device. */
+	histo->video.queue = &histo->queue;
+	ret = video_register_device(&histo->video, VFL_TYPE_GRABBER, -1);
+	if (ret < 0) {
+		dev_err(vsp2->dev, "failed to register video device\n");
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * vsp2_histogram_init - Initialize a histogram entity
+ * @vsp2: the VSP2 device
+ * @histo: the histogram entity, with the entity type set by the caller
+ * @name: subdev name suffix
+ * @ops: V4L2 subdev operations
+ * @pixelformat: format of the histogram buffers
+ * @data_size: size of the histogram data in bytes
+ *
+ * Initialize the entity and its subdev, and create the histogram video node
+ * connected to the source pad. The caller is responsible for the control
+ * handler.
+ */
+int vsp2_histogram_init(struct vsp2_device *vsp2,
+			struct vsp2_histogram *histo, const char *name,
+			const struct v4l2_subdev_ops *ops, u32 pixelformat,
+			size_t data_size)
+{
+	struct v4l2_subdev *subdev;
+	u32 flags;
+	int ret;
+
+	histo->pixelformat = pixelformat;
+	histo->data_size = data_size;
+	histo->data = dmam_alloc_coherent(vsp2->dev, data_size, &histo->dma,
+					  GFP_KERNEL);
+	if (histo->data == NULL)
+		return -ENOMEM;
+
+	ret = vsp2_entity_init(vsp2, &histo->entity, 2);
+	if (ret < 0)
+		return ret;
+
+	/* Initialize the V4L2 subdev. */
+	subdev = &histo->entity.subdev;
+	v4l2_subdev_init(subdev, ops);
+
+	subdev->entity.ops = &vsp2_media_ops;
+	subdev->internal_ops = &vsp2_subdev_internal_ops;
+	snprintf(subdev->name, sizeof(subdev->name), "%s %s",
+		 dev_name(vsp2->dev), name);
+	v4l2_set_subdevdata(subdev, histo);
+	subdev->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	vsp2_entity_init_formats(subdev, NULL);
+
+	/* Initialize the histogram video node and connect it to the entity.
+	 * The connection is immutable.
+	 */
+	ret = vsp2_histogram_init_video(histo);
+	if (ret < 0)
+		goto error;
+
+	flags = MEDIA_LNK_FL_ENABLED;
+	flags |= MEDIA_LNK_FL_IMMUTABLE;
+
+	ret = media_entity_create_link(&histo->entity.subdev.entity,
+				       HISTO_PAD_SOURCE, &histo->video.entity,
+				       0, flags);
+	if (ret < 0)
+		goto error;
+
+	histo->entity.sink = &histo->video.entity;
+
+	return 0;
+
+error:
+	vsp2_histogram_cleanup(histo);
+	vsp2_entity_destroy(&histo->entity);
+	return ret;
+}
+
+void vsp2_histogram_cleanup(struct vsp2_histogram *histo)
+{
+	if (video_is_registered(&histo->video))
+		video_unregister_device(&histo->video);
+
+	media_entity_cleanup(&histo->video.entity);
+}
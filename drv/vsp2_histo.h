@@ -0,0 +1,144 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#ifndef __VSP2_HISTO_H__
+#define __VSP2_HISTO_H__
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+
+#include <media/media-entity.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-subdev.h>
+#include <media/videobuf2-core.h>
+
+#include "vsp2_entity.h"
+
+struct vsp2_device;
+
+#define HISTO_PAD_SINK				0
+#define HISTO_PAD_SOURCE			1
+
+struct vsp2_histogram_buffer {
+	struct vb2_buffer buf;
+	struct list_head queue;
+};
+
+static inline struct vsp2_histogram_buffer *
+to_vsp2_histogram_buffer(struct vb2_buffer *vb)
+{
+	return container_of(vb, struct vsp2_histogram_buffer, buf);
+}
+
+/*
+ * struct vsp2_histogram - Histogram entity base
+ * @entity: the HGO or HGT entity
+ * @pixelformat: format of the histogram buffers
+ * @data_size: size of the histogram data in bytes
+ * @data: histogram data written by the VSPM at the end of each job
+ * @dma: DMA address of @data
+ * @video: metadata capture video node
+ * @pad: media pad of the video node
+ * @queue: buffers queue of the video node
+ * @lock: serializes the video node ioctls
+ * @irqlock: protects @irqqueue
+ * @irqqueue: buffers waiting for histogram data
+ *
+ * The histogram entities sample the data path at the output of the entity
+ * their sink pad is linked to, and deliver the histogram through the video
+ * node connected to their source pad.
+ */
+struct vsp2_histogram {
+	struct vsp2_entity entity;
+
+	u32 pixelformat;
+	size_t data_size;
+	void *data;
+	dma_addr_t dma;
+
+	struct video_device video;
+	struct media_pad pad;
+	struct vb2_queue queue;
+	struct mutex lock;
+
+	spinlock_t irqlock;
+	struct list_head irqqueue;
+};
+
+static inline struct vsp2_histogram *to_histogram(struct v4l2_subdev *subdev)
+{
+	return container_of(subdev, struct vsp2_histogram, entity.subdev);
+}
+
+extern const struct v4l2_subdev_pad_ops vsp2_histogram_pad_ops;
+
+int vsp2_histogram_init(struct vsp2_device *vsp2,
+			struct vsp2_histogram *histo, const char *name,
+			const struct v4l2_subdev_ops *ops, u32 pixelformat,
+			size_t data_size);
+void vsp2_histogram_cleanup(struct vsp2_histogram *histo);
+
+int vsp2_histogram_sampling(struct vsp2_histogram *histo);
+void vsp2_histogram_frame_end(struct vsp2_histogram *histo, u32 sequence,
+			      const struct timeval *timestamp);
+
+#endif /* __VSP2_HISTO_H__ */
@@ -0,0 +1,233 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_hsi.h"
+
+#define HSI_MIN_SIZE				1U
+#define HSI_MAX_SIZE				8190U
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int hsi_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_hsi *hsi = to_hsi(subdev);
+
+	return vsp2_entity_set_streaming(&hsi->entity, enable);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Pad Operations
+ */
+
+/*
+ * There is no HSV media bus code, the HSI input is described with the ARGB
+ * code and carries the hue, saturation and value in the R, G and B components
+ * respectively.
+ */
+static int hsi_enum_mbus_code(struct v4l2_subdev *subdev,
+			      struct v4l2_subdev_fh *fh,
+			      struct v4l2_subdev_mbus_code_enum *code)
+{
+	if (code->index)
+		return -EINVAL;
+
+	code->code = V4L2_MBUS_FMT_ARGB8888_1X32;
+
+	return 0;
+}
+
+static int hsi_enum_frame_size(struct v4l2_subdev *subdev,
+			       struct v4l2_subdev_fh *fh,
+			       struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct v4l2_mbus_framefmt *format;
+
+	format = v4l2_subdev_get_try_format(fh, fse->pad);
+
+	if (fse->index || fse->code != format->code)
+		return -EINVAL;
+
+	if (fse->pad == HSI_PAD_SINK) {
+		fse->min_width = HSI_MIN_SIZE;
+		fse->max_width = HSI_MAX_SIZE;
+		fse->min_height = HSI_MIN_SIZE;
+		fse->max_height = HSI_MAX_SIZE;
+	} else {
+		/* The size on the source pad are fixed and always identical to
+		 * the size on the sink pad.
+		 */
+		fse->min_width = format->width;
+		fse->max_width = format->width;
+		fse->min_height = format->height;
+		fse->max_height = format->height;
+	}
+
+	return 0;
+}
+
+static int hsi_get_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_hsi *hsi = to_hsi(subdev);
+
+	fmt->format = *vsp2_entity_get_pad_format(&hsi->entity, fh, fmt->pad,
+						  fmt->which);
+
+	return 0;
+}
+
+static int hsi_set_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_hsi *hsi = to_hsi(subdev);
+	struct v4l2_mbus_framefmt *format;
+
+	format = vsp2_entity_get_pad_format(&hsi->entity, fh, fmt->pad,
+					    fmt->which);
+
+	if (fmt->pad == HSI_PAD_SOURCE) {
+		/* The HSI output format can't be modified. */
+		fmt->format = *format;
+		return 0;
+	}
+
+	/* The HSI only accepts HSV input and outputs RGB. */
+	format->code = V4L2_MBUS_FMT_ARGB8888_1X32;
+	format->width = clamp_t(unsigned int, fmt->format.width,
+				HSI_MIN_SIZE, HSI_MAX_SIZE);
+	format->height = clamp_t(unsigned int, fmt->format.height,
+				 HSI_MIN_SIZE, HSI_MAX_SIZE);
+	format->field = V4L2_FIELD_NONE;
+	format->colorspace = V4L2_COLORSPACE_SRGB;
+
+	fmt->format = *format;
+
+	/* Propagate the format to the source pad. */
+	format = vsp2_entity_get_pad_format(&hsi->entity, fh, HSI_PAD_SOURCE,
+					    fmt->which);
+	*format = fmt->format;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops hsi_video_ops = {
+	.s_stream = hsi_s_stream,
+};
+
+static struct v4l2_subdev_pad_ops hsi_pad_ops = {
+	.enum_mbus_code = hsi_enum_mbus_code,
+	.enum_frame_size = hsi_enum_frame_size,
+	.get_fmt = hsi_get_format,
+	.set_fmt = hsi_set_format,
+};
+
+static struct v4l2_subdev_ops hsi_ops = {
+	.video	= &hsi_video_ops,
+	.pad    = &hsi_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_hsi *vsp2_hsi_create(struct vsp2_device *vsp2)
+{
+	struct v4l2_subdev *subdev;
+	struct vsp2_hsi *hsi;
+	int ret;
+
+	hsi = devm_kzalloc(vsp2->dev, sizeof(*hsi), GFP_KERNEL);
+	if (hsi == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	hsi->entity.type = VSP2_ENTITY_HSI;
+
+	ret = vsp2_entity_init(vsp2, &hsi->entity, 2);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the V4L2 subdev. */
+	subdev = &hsi->entity.subdev;
+	v4l2_subdev_init(subdev, &hsi_ops);
+
+	subdev->entity.ops = &vsp2_media_ops;
+	subdev->internal_ops = &vsp2_subdev_internal_ops;
+	snprintf(subdev->name, sizeof(subdev->name), "%s hsi",
+		 dev_name(vsp2->dev));
+	v4l2_set_subdevdata(subdev, hsi);
+	subdev->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	vsp2_entity_init_formats(subdev, NULL);
+
+	return hsi;
+}
@@ -0,0 +1,316 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_hst.h"
+#include "vsp2_video.h"
+
+#define HST_MIN_SIZE				1U
+#define HST_MAX_SIZE				8190U
+
+/* -----------------------------------------------------------------------------
+ * Controls
+ */
+
+static int hst_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_hst *hst =
+		container_of(ctrl->handler, struct vsp2_hst, ctrls);
+	unsigned long flags;
+
+	spin_lock_irqsave(&hst->lock, flags);
+
+	switch (ctrl->id) {
+	case V4L2_CID_HUE:
+		hst->adjust.hue = ctrl->val;
+		break;
+
+	case V4L2_CID_SATURATION:
+		hst->adjust.saturation = ctrl->val;
+		break;
+
+	case V4L2_CID_BRIGHTNESS:
+		hst->adjust.value = ctrl->val;
+		break;
+	}
+
+	spin_unlock_irqrestore(&hst->lock, flags);
+
+	if (vsp2_entity_is_streaming(&hst->entity))
+		vsp2_pipeline_invalidate_job(
+			to_vsp2_pipeline(&hst->entity.subdev.entity));
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops hst_ctrl_ops = {
+	.s_ctrl = hst_s_ctrl,
+};
+
+/*
+ * vsp2_hst_get_adjust - Get the HSV adjustment parameters
+ * @hst: the HST
+ * @adjust: the adjustment parameters
+ *
+ * The HST and HSI only convert between RGB and HSV, the adjustments are
+ * applied by the LUT when it is placed between them.
+ */
+void vsp2_hst_get_adjust(struct vsp2_hst *hst, struct vsp2_hsv_adjust *adjust)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hst->lock, flags);
+	*adjust = hst->adjust;
+	spin_unlock_irqrestore(&hst->lock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int hst_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_hst *hst = to_hst(subdev);
+
+	return vsp2_entity_set_streaming(&hst->entity, enable);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Pad Operations
+ */
+
+/*
+ * There is no HSV media bus code, the HST output is described with the ARGB
+ * code and carries the hue, saturation and value in the R, G and B components
+ * respectively.
+ */
+static int hst_enum_mbus_code(struct v4l2_subdev *subdev,
+			      struct v4l2_subdev_fh *fh,
+			      struct v4l2_subdev_mbus_code_enum *code)
+{
+	if (code->index)
+		return -EINVAL;
+
+	code->code = V4L2_MBUS_FMT_ARGB8888_1X32;
+
+	return 0;
+}
+
+static int hst_enum_frame_size(struct v4l2_subdev *subdev,
+			       struct v4l2_subdev_fh *fh,
+			       struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct v4l2_mbus_framefmt *format;
+
+	format = v4l2_subdev_get_try_format(fh, fse->pad);
+
+	if (fse->index || fse->code != format->code)
+		return -EINVAL;
+
+	if (fse->pad == HST_PAD_SINK) {
+		fse->min_width = HST_MIN_SIZE;
+		fse->max_width = HST_MAX_SIZE;
+		fse->min_height = HST_MIN_SIZE;
+		fse->max_height = HST_MAX_SIZE;
+	} else {
+		/* The size on the source pad are fixed and always identical to
+		 * the size on the sink pad.
+		 */
+		fse->min_width = format->width;
+		fse->max_width = format->width;
+		fse->min_height = format->height;
+		fse->max_height = format->height;
+	}
+
+	return 0;
+}
+
+static int hst_get_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_hst *hst = to_hst(subdev);
+
+	fmt->format = *vsp2_entity_get_pad_format(&hst->entity, fh, fmt->pad,
+						  fmt->which);
+
+	return 0;
+}
+
+static int hst_set_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_hst *hst = to_hst(subdev);
+	struct v4l2_mbus_framefmt *format;
+
+	format = vsp2_entity_get_pad_format(&hst->entity, fh, fmt->pad,
+					    fmt->which);
+
+	if (fmt->pad == HST_PAD_SOURCE) {
+		/* The HST output format can't be modified. */
+		fmt->format = *format;
+		return 0;
+	}
+
+	/* The HST only accepts RGB input. */
+	format->code = V4L2_MBUS_FMT_ARGB8888_1X32;
+	format->width = clamp_t(unsigned int, fmt->format.width,
+				HST_MIN_SIZE, HST_MAX_SIZE);
+	format->height = clamp_t(unsigned int, fmt->format.height,
+				 HST_MIN_SIZE, HST_MAX_SIZE);
+	format->field = V4L2_FIELD_NONE;
+	format->colorspace = V4L2_COLORSPACE_SRGB;
+
+	fmt->format = *format;
+
+	/* Propagate the format to the source pad. */
+	format = vsp2_entity_get_pad_format(&hst->entity, fh, HST_PAD_SOURCE,
+					    fmt->which);
+	*format = fmt->format;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops hst_video_ops = {
+	.s_stream = hst_s_stream,
+};
+
+static struct v4l2_subdev_pad_ops hst_pad_ops = {
+	.enum_mbus_code = hst_enum_mbus_code,
+	.enum_frame_size = hst_enum_frame_size,
+	.get_fmt = hst_get_format,
+	.set_fmt = hst_set_format,
+};
+
+static struct v4l2_subdev_ops hst_ops = {
+	.video	= &hst_video_ops,
+	.pad    = &hst_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_hst *vsp2_hst_create(struct vsp2_device *vsp2)
+{
+	struct v4l2_subdev *subdev;
+	struct vsp2_hst *hst;
+	int ret;
+
+	hst = devm_kzalloc(vsp2->dev, sizeof(*hst), GFP_KERNEL);
+	if (hst == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&hst->lock);
+
+	hst->entity.type = VSP2_ENTITY_HST;
+
+	ret = vsp2_entity_init(vsp2, &hst->entity, 2);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the V4L2 subdev. */
+	subdev = &hst->entity.subdev;
+	v4l2_subdev_init(subdev, &hst_ops);
+
+	subdev->entity.ops = &vsp2_media_ops;
+	subdev->internal_ops = &vsp2_subdev_internal_ops;
+	snprintf(subdev->name, sizeof(subdev->name), "%s hst",
+		 dev_name(vsp2->dev));
+	v4l2_set_subdevdata(subdev, hst);
+	subdev->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	vsp2_entity_init_formats(subdev, NULL);
+
+	/* Initialize the control handler. The hue is rotated by the hue
+	 * control value, the saturation and value are scaled by the saturation
+	 * and brightness control values in 1/128 units.
+	 */
+	v4l2_ctrl_handler_init(&hst->ctrls, 3);
+	v4l2_ctrl_new_std(&hst->ctrls, &hst_ctrl_ops, V4L2_CID_HUE,
+			  -128, 127, 1, 0);
+	v4l2_ctrl_new_std(&hst->ctrls, &hst_ctrl_ops, V4L2_CID_SATURATION,
+			  0, 255, 1, 128);
+	v4l2_ctrl_new_std(&hst->ctrls, &hst_ctrl_ops, V4L2_CID_BRIGHTNESS,
+			  0, 255, 1, 128);
+
+	hst->entity.subdev.ctrl_handler = &hst->ctrls;
+
+	if (hst->ctrls.error) {
+		dev_err(vsp2->dev, "hst: failed to initialize controls\n");
+		ret = hst->ctrls.error;
+		vsp2_entity_destroy(&hst->entity);
+		return ERR_PTR(ret);
+	}
+
+	hst->adjust.saturation = 128;
+	hst->adjust.value = 128;
+
+	return hst;
+}
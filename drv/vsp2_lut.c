@@ -0,0 +1,401 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/gfp.h>
+
+#include <media/v4l2-subdev.h>
+
+#include "vsp2.h"
+#include "vsp2_lut.h"
+#include "vsp2_video.h"
+#include "vsp2_vspm.h"
+
+#define LUT_MIN_SIZE				1U
+#define LUT_MAX_SIZE				8190U
+
+/* -----------------------------------------------------------------------------
+ * Controls
+ */
+
+static int lut_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_lut *lut =
+		container_of(ctrl->handler, struct vsp2_lut, ctrls);
+	unsigned long flags;
+
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_LUT_TABLE:
+		spin_lock_irqsave(&lut->lock, flags);
+		memcpy(lut->shadow, ctrl->p_new.p_u32, sizeof(lut->shadow));
+		lut->dirty = true;
+		spin_unlock_irqrestore(&lut->lock, flags);
+		break;
+	}
+
+	if (vsp2_entity_is_streaming(&lut->entity))
+		vsp2_pipeline_invalidate_job(
+			to_vsp2_pipeline(&lut->entity.subdev.entity));
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops lut_ctrl_ops = {
+	.s_ctrl = lut_s_ctrl,
+};
+
+/*
+ * The table control holds one 0x00RRGGBB (or 0x00YYUUVV) entry per input
+ * component value. Each output component is looked up independently in the
+ * corresponding byte of the entry. The table can be modified while streaming,
+ * the new table is used starting at the next job.
+ */
+static const struct v4l2_ctrl_config lut_table_control = {
+	.ops = &lut_ctrl_ops,
+	.id = V4L2_CID_VSP2_LUT_TABLE,
+	.name = "Look-Up Table",
+	.type = V4L2_CTRL_TYPE_U32,
+	.min = 0x00000000,
+	.max = 0x00ffffff,
+	.step = 1,
+	.def = 0,
+	.dims = { LUT_SIZE },
+};
+
+/* -----------------------------------------------------------------------------
+ * Job Configuration
+ */
+
+static const struct vsp2_hsv_adjust lut_no_adjust = {
+	.hue = 0,
+	.saturation = 128,
+	.value = 128,
+};
+
+static u32 lut_adjust_entry(u32 entry, const struct vsp2_hsv_adjust *adjust)
+{
+	unsigned int h = (entry >> 16) & 0xff;
+	unsigned int s = (entry >> 8) & 0xff;
+	unsigned int v = (entry >> 0) & 0xff;
+
+	h = (h + adjust->hue) & 0xff;
+	s = min(s * adjust->saturation / 128, 255U);
+	v = min(v * adjust->value / 128, 255U);
+
+	return (h << 16) | (s << 8) | (v << 0);
+}
+
+/*
+ * vsp2_lut_configure - Configure the LUT for the next job
+ * @lut: the LUT
+ * @adjust: HSV adjustment, or NULL if the LUT doesn't process HSV data
+ *
+ * Copy the shadow table to the display list when it or the HSV adjustment has
+ * been modified. The adjustment is applied to the table output, the hue being
+ * rotated and the saturation and value scaled. The jobs are serialized, the
+ * display list isn't in use by the VSPM when the next job is configured.
+ */
+void vsp2_lut_configure(struct vsp2_lut *lut,
+			const struct vsp2_hsv_adjust *adjust)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	if (adjust == NULL)
+		adjust = &lut_no_adjust;
+
+	spin_lock_irqsave(&lut->lock, flags);
+
+	if (lut->dirty || memcmp(&lut->adjust, adjust, sizeof(*adjust))) {
+		for (i = 0; i < LUT_SIZE; ++i)
+			lut->entries[i].data =
+				lut_adjust_entry(lut->shadow[i], adjust);
+
+		lut->adjust = *adjust;
+		lut->dirty = false;
+	}
+
+	spin_unlock_irqrestore(&lut->lock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int lut_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_lut *lut = to_lut(subdev);
+	int ret;
+	VSPM_VSP_PAR *vsp_par =
+		lut->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_LUT *vsp_lut = vsp_par->ctrl_par->lut;
+
+	ret = vsp2_entity_set_streaming(&lut->entity, enable);
+	if (ret < 0)
+		return ret;
+
+	if (!enable)
+		return 0;
+
+	/* The table is updated by vsp2_lut_configure() for every job. */
+	vsp_lut->lut.hard_addr = (void *)(unsigned long)lut->dma;
+	vsp_lut->lut.virt_addr = lut->entries;
+	vsp_lut->lut.tbl_num = LUT_SIZE;
+	vsp_lut->fxa = 0;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Pad Operations
+ */
+
+static int lut_enum_mbus_code(struct v4l2_subdev *subdev,
+			      struct v4l2_subdev_fh *fh,
+			      struct v4l2_subdev_mbus_code_enum *code)
+{
+	static const unsigned int codes[] = {
+		V4L2_MBUS_FMT_ARGB8888_1X32,
+		V4L2_MBUS_FMT_AYUV8_1X32,
+	};
+	struct v4l2_mbus_framefmt *format;
+
+	if (code->pad == LUT_PAD_SINK) {
+		if (code->index >= ARRAY_SIZE(codes))
+			return -EINVAL;
+
+		code->code = codes[code->index];
+	} else {
+		/* The LUT can't perform format conversion, the sink format is
+		 * always identical to the source format.
+		 */
+		if (code->index)
+			return -EINVAL;
+
+		format = v4l2_subdev_get_try_format(fh, LUT_PAD_SINK);
+		code->code = format->code;
+	}
+
+	return 0;
+}
+
+static int lut_enum_frame_size(struct v4l2_subdev *subdev,
+			       struct v4l2_subdev_fh *fh,
+			       struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct v4l2_mbus_framefmt *format;
+
+	format = v4l2_subdev_get_try_format(fh, fse->pad);
+
+	if (fse->index || fse->code != format->code)
+		return -EINVAL;
+
+	if (fse->pad == LUT_PAD_SINK) {
+		fse->min_width = LUT_MIN_SIZE;
+		fse->max_width = LUT_MAX_SIZE;
+		fse->min_height = LUT_MIN_SIZE;
+		fse->max_height = LUT_MAX_SIZE;
+	} else {
+		/* The size on the source pad are fixed and always identical to
+		 * the size on the sink pad.
+		 */
+		fse->min_width = format->width;
+		fse->max_width = format->width;
+		fse->min_height = format->height;
+		fse->max_height = format->height;
+	}
+
+	return 0;
+}
+
+static int lut_get_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_lut *lut = to_lut(subdev);
+
+	fmt->format = *vsp2_entity_get_pad_format(&lut->entity, fh, fmt->pad,
+						  fmt->which);
+
+	return 0;
+}
+
+static int lut_set_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
+			  struct v4l2_subdev_format *fmt)
+{
+	struct vsp2_lut *lut = to_lut(subdev);
+	struct v4l2_mbus_framefmt *format;
+
+	/* Default to YUV if the requested format is not supported. */
+	if (fmt->format.code != V4L2_MBUS_FMT_ARGB8888_1X32 &&
+	    fmt->format.code != V4L2_MBUS_FMT_AYUV8_1X32)
+		fmt->format.code = V4L2_MBUS_FMT_AYUV8_1X32;
+
+	format = vsp2_entity_get_pad_format(&lut->entity, fh, fmt->pad,
+					    fmt->which);
+
+	if (fmt->pad == LUT_PAD_SOURCE) {
+		/* The LUT output format can't be modified. */
+		fmt->format = *format;
+		return 0;
+	}
+
+	format->code = fmt->format.code;
+	format->width = clamp_t(unsigned int, fmt->format.width,
+				LUT_MIN_SIZE, LUT_MAX_SIZE);
+	format->height = clamp_t(unsigned int, fmt->format.height,
+				 LUT_MIN_SIZE, LUT_MAX_SIZE);
+	format->field = V4L2_FIELD_NONE;
+	format->colorspace = V4L2_COLORSPACE_SRGB;
+
+	fmt->format = *format;
+
+	/* Propagate the format to the source pad. */
+	format = vsp2_entity_get_pad_format(&lut->entity, fh, LUT_PAD_SOURCE,
+					    fmt->which);
+	*format = fmt->format;
+
+	return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Operations
+ */
+
+static struct v4l2_subdev_video_ops lut_video_ops = {
+	.s_stream = lut_s_stream,
+};
+
+static struct v4l2_subdev_pad_ops lut_pad_ops = {
+	.enum_mbus_code = lut_enum_mbus_code,
+	.enum_frame_size = lut_enum_frame_size,
+	.get_fmt = lut_get_format,
+	.set_fmt = lut_set_format,
+};
+
+static struct v4l2_subdev_ops lut_ops = {
+	.video	= &lut_video_ops,
+	.pad    = &lut_pad_ops,
+};
+
+/* -----------------------------------------------------------------------------
+ * Initialization and Cleanup
+ */
+
+struct vsp2_lut *vsp2_lut_create(struct vsp2_device *vsp2)
+{
+	struct v4l2_subdev *subdev;
+	struct vsp2_lut *lut;
+	unsigned int i;
+	int ret;
+
+	lut = devm_kzalloc(vsp2->dev, sizeof(*lut), GFP_KERNEL);
+	if (lut == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	spin_lock_init(&lut->lock);
+
+	/* The display list holds one register write per table entry. */
+	lut->entries = dmam_alloc_coherent(vsp2->dev,
+					   LUT_SIZE * sizeof(*lut->entries),
+					   &lut->dma, GFP_KERNEL);
+	if (lut->entries == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < LUT_SIZE; ++i)
+		lut->entries[i].addr = VI6_LUT_TABLE + i * 4;
+
+	lut->entity.type = VSP2_ENTITY_LUT;
+
+	ret = vsp2_entity_init(vsp2, &lut->entity, 2);
+	if (ret < 0)
+		return ERR_PTR(ret);
+
+	/* Initialize the V4L2 subdev. */
+	subdev = &lut->entity.subdev;
+	v4l2_subdev_init(subdev, &lut_ops);
+
+	subdev->entity.ops = &vsp2_media_ops;
+	subdev->internal_ops = &vsp2_subdev_internal_ops;
+	snprintf(subdev->name, sizeof(subdev->name), "%s lut",
+		 dev_name(vsp2->dev));
+	v4l2_set_subdevdata(subdev, lut);
+	subdev->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	vsp2_entity_init_formats(subdev, NULL);
+
+	/* Initialize the control handler. The table control is set up when
+	 * the stream starts, which fills the display list.
+	 */
+	v4l2_ctrl_handler_init(&lut->ctrls, 1);
+	v4l2_ctrl_new_custom(&lut->ctrls, &lut_table_control, NULL);
+
+	lut->entity.subdev.ctrl_handler = &lut->ctrls;
+
+	if (lut->ctrls.error) {
+		dev_err(vsp2->dev, "lut: failed to initialize controls\n");
+		ret = lut->ctrls.error;
+		vsp2_entity_destroy(&lut->entity);
+		return ERR_PTR(ret);
+	}
+
+	return lut;
+}
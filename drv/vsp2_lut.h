@@ -0,0 +1,124 @@
+/*************************************************************************/ /*
+ VSP2
+
+ Copyright (C) 2015 Renesas Electronics Corporation
+
+ License        Dual MIT/GPLv2
+
+ The contents of this file are subject to the MIT license as set out below.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ Alternatively, the contents of this file may be used under the terms of
+ the GNU General Public License Version 2 ("GPL") in which case the provisions
+ of GPL are applicable instead of those above.
+
+ If you wish to allow use of your version of this file only under the terms of
+ GPL, and not to allow others to use your version of this file under the terms
+ of the MIT license, indicate your decision by deleting the provisions above
+ and replace them with the notice and other provisions required by GPL as set
+ out in the file called "GPL-COPYING" included in this distribution. If you do
+ not delete the provisions above, a recipient may use your version of this file
+ under the terms of either the MIT license or GPL.
+
+ This License is also included in this distribution in the file called
+ "MIT-COPYING".
+
+ EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+ PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+ GPLv2:
+ If you wish to use this file under the terms of GPL, following terms are
+ effective.
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; version 2 of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/ /*************************************************************************/
+
+#ifndef __VSP2_LUT_H__
+#define __VSP2_LUT_H__
+
+#include <linux/spinlock.h>
+
+#include <media/media-entity.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-subdev.h>
+
+#include "vsp2_entity.h"
+#include "vsp2_hst.h"
+
+struct vsp2_device;
+
+#define LUT_PAD_SINK				0
+#define LUT_PAD_SOURCE				1
+
+#define LUT_SIZE				256
+
+/*
+ * struct vsp2_lut_entry - 1D LUT display list entry
+ * @addr: table register address
+ * @data: table register value
+ */
+struct vsp2_lut_entry {
+	u32 addr;
+	u32 data;
+};
+
+/*
+ * struct vsp2_lut - 1D LUT entity
+ * @lock: protects the shadow table and the dirty flag
+ * @shadow: table set through the table control, applied at the next job
+ * @dirty: the shadow table has been modified since the last job
+ * @adjust: HSV adjustment applied to the display list
+ * @entries: display list read by the VSPM
+ * @dma: DMA address of @entries
+ */
+struct vsp2_lut {
+	struct vsp2_entity entity;
+
+	struct v4l2_ctrl_handler ctrls;
+
+	spinlock_t lock;
+	u32 shadow[LUT_SIZE];
+	bool dirty;
+	struct vsp2_hsv_adjust adjust;
+
+	struct vsp2_lut_entry *entries;
+	dma_addr_t dma;
+};
+
+static inline struct vsp2_lut *to_lut(struct v4l2_subdev *subdev)
+{
+	return container_of(subdev, struct vsp2_lut, entity.subdev);
+}
+
+struct vsp2_lut *vsp2_lut_create(struct vsp2_device *vsp2);
+
+void vsp2_lut_configure(struct vsp2_lut *lut,
+			const struct vsp2_hsv_adjust *adjust);
+
+#endif /* __VSP2_LUT_H__ */
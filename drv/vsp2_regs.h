@@ -678,6 +678,7 @@
  */
 
 #define VI6_CLUT_TABLE			0x4000
+#define VI6_CLUT_OFFSET			0x400
 
 /* -----------------------------------------------------------------------------
  * 1D LUT Registers
@@ -731,6 +732,7 @@
 #define VI6_FMT_XBXGXR_262626		0x21
 #define VI6_FMT_ABGR_8888		0x22
 #define VI6_FMT_XXRGB_88565		0x23
+#define VI6_FMT_RGB_CLUT8		0x3f
 
 #define VI6_FMT_Y_UV_444		0x40
 #define VI6_FMT_Y_UV_422		0x41
@@ -742,5 +744,6 @@
 #define VI6_FMT_Y_U_V_444		0x4a
 #define VI6_FMT_Y_U_V_422		0x4b
 #define VI6_FMT_Y_U_V_420		0x4c
+#define VI6_FMT_YUV_CLUT8		0x7f
 
 #endif /* __VSP2_REGS_H__ */
@@ -60,10 +60,13 @@
 */ /*************************************************************************/
 
 #include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/gfp.h>
 
 #include <media/v4l2-subdev.h>
 
 #include "vsp2.h"
+#include "vsp2_lut.h"
 #include "vsp2_rwpf.h"
 #include "vsp2_video.h"
 #include "vsp2_vspm.h"
@@ -71,43 +74,78 @@
 #define RPF_MAX_WIDTH				8190
 #define RPF_MAX_HEIGHT				8190
 
-static T_VSP_IN *rpf_get_vsp_in(struct vsp2_rwpf *rpf)
+/* The external alpha plane holds one byte per pixel. */
+#define RPF_ALPHA_PLANE_SWAP	(VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS | \
+				 VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS)
+
+/* Number of planes holding the color components. */
+static unsigned int rpf_color_planes(struct vsp2_rwpf *rpf)
 {
-	T_VSP_IN *vsp_in = NULL;
-	VSPM_VSP_PAR *vsp_par =
-		rpf->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	return rpf->video.format.num_planes
+	     - (rpf->video.fmtinfo->alpha_plane ? 1 : 0);
+}
 
-	switch (rpf->entity.index) {
-	case 0:
-		vsp_in = vsp_par->src1_par;
-		break;
-	case 1:
-		vsp_in = vsp_par->src2_par;
-		break;
-	case 2:
-		vsp_in = vsp_par->src3_par;
-		break;
-	case 3:
-		vsp_in = vsp_par->src4_par;
-		break;
-	default:
-		/* Invalid index. */
-		break;
-	}
+static T_VSP_IN *rpf_get_vsp_in(struct vsp2_rwpf *rpf)
+{
+	if (rpf->entity.index >= VSP2_COUNT_RPF)
+		return NULL;
 
-	return vsp_in;
+	return rpf->entity.vsp2->vspm->in[rpf->entity.index];
 }
 
 /* -----------------------------------------------------------------------------
  * Controls
  */
 
+/* The virtual layer color combines the RGB color and the fixed alpha value. */
+static u32 rpf_vircolor(struct vsp2_rwpf *rpf, unsigned int alpha)
+{
+	return rpf->vircolor | (alpha << VI6_RPF_VRTCOL_SET_LAYA_SHIFT);
+}
+
+/*
+ * The color key is implemented with the mask function: the input pixels that
+ * match the key color are replaced by the mask color, which is set to the key
+ * color with a fully transparent alpha component.
+ */
+/*
+ * The VSPM programs the source slots in order, the input using slot n is read
+ * by RPF n and its palette must be written to the CLUT table of that RPF.
+ */
+static void rpf_set_clut_slot(struct vsp2_rwpf *rpf, unsigned int slot)
+{
+	unsigned int i;
+
+	for (i = 0; i < RPF_CLUT_SIZE; ++i)
+		rpf->clut[i].addr = VI6_CLUT_TABLE + slot * VI6_CLUT_OFFSET
+				  + i * 4;
+
+	rpf->clut_slot = slot;
+}
+
+static void rpf_set_color_key(struct vsp2_rwpf *rpf, T_VSP_IN *vsp_in)
+{
+	if (!rpf->ckey_enable) {
+		vsp_in->alpha_blend->msken = VSP_MSKEN_ALPHA;
+		vsp_in->alpha_blend->mgcolor = 0;
+		vsp_in->alpha_blend->mscolor0 = 0;
+		vsp_in->alpha_blend->mscolor1 = 0;
+		return;
+	}
+
+	vsp_in->alpha_blend->msken = VSP_MSKEN_COLOR;
+	vsp_in->alpha_blend->mgcolor = rpf->ckey_color;
+	vsp_in->alpha_blend->mscolor0 = rpf->ckey_color;
+	vsp_in->alpha_blend->mscolor1 = rpf->ckey_color;
+}
+
 static int rpf_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct vsp2_rwpf *rpf =
 		container_of(ctrl->handler, struct vsp2_rwpf, ctrls);
 	struct vsp2_pipeline *pipe;
 	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
+	unsigned long flags;
 
 	if (vsp_in == NULL) {
 		dev_err(rpf->entity.vsp2->dev,
@@ -115,16 +153,53 @@ static int rpf_s_ctrl(struct v4l2_ctrl *ctrl)
 		return -EINVAL;
 	}
 
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_RPF_VIRTUAL:
+		/* The virtual mode decides whether the video node takes part
+		 * in the pipeline, the control is grabbed by the pipeline.
+		 */
+		rpf->virtual = ctrl->val;
+		return 0;
+	case V4L2_CID_VSP2_RPF_VIRTUAL_COLOR:
+		rpf->vircolor = ctrl->val;
+		break;
+	case V4L2_CID_VSP2_RPF_PALETTE:
+		spin_lock_irqsave(&rpf->palette_lock, flags);
+		memcpy(rpf->palette, ctrl->p_new.p_u32, sizeof(rpf->palette));
+		rpf->palette_dirty = true;
+		spin_unlock_irqrestore(&rpf->palette_lock, flags);
+		break;
+	case V4L2_CID_VSP2_RPF_CKEY_ENABLE:
+		rpf->ckey_enable = ctrl->val;
+		break;
+	case V4L2_CID_VSP2_RPF_CKEY_COLOR:
+		rpf->ckey_color = ctrl->val;
+		break;
+	}
+
 	if (!vsp2_entity_is_streaming(&rpf->entity))
 		return 0;
 
+	pipe = to_vsp2_pipeline(&rpf->entity.subdev.entity);
+
 	switch (ctrl->id) {
 	case V4L2_CID_ALPHA_COMPONENT:
-		vsp_in->alpha_blend->afix = ctrl->val;
+		vsp2_pipeline_set_alpha(pipe, rpf, ctrl->val);
+		break;
 
-		pipe = to_vsp2_pipeline(&rpf->entity.subdev.entity);
-		vsp2_pipeline_propagate_alpha(pipe, &rpf->entity, ctrl->val);
-		rpf->alpha = ctrl->val;
+	case V4L2_CID_VSP2_RPF_VIRTUAL_COLOR:
+		vsp_in->vircolor = rpf_vircolor(rpf, rpf->alpha);
+		vsp2_pipeline_invalidate_job(pipe);
+		break;
+
+	case V4L2_CID_VSP2_RPF_PALETTE:
+		vsp2_pipeline_invalidate_job(pipe);
+		break;
+
+	case V4L2_CID_VSP2_RPF_CKEY_ENABLE:
+	case V4L2_CID_VSP2_RPF_CKEY_COLOR:
+		rpf_set_color_key(rpf, vsp_in);
+		vsp2_pipeline_invalidate_job(pipe);
 		break;
 	}
 
@@ -135,77 +210,128 @@ static const struct v4l2_ctrl_ops rpf_ctrl_ops = {
 	.s_ctrl = rpf_s_ctrl,
 };
 
-/* -----------------------------------------------------------------------------
- * V4L2 Subdevice Core Operations
+/*
+ * The virtual mode turns the RPF into a solid color source. The layer size is
+ * the RPF crop rectangle size and its position the BRU compose rectangle
+ * position, the video node isn't used and doesn't need to be streamed.
  */
+static const struct v4l2_ctrl_config rpf_ctrl_virtual = {
+	.ops = &rpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_RPF_VIRTUAL,
+	.name = "Virtual Input",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.min = 0,
+	.max = 1,
+	.step = 1,
+	.def = 0,
+};
 
-static int rpf_s_stream(struct v4l2_subdev *subdev, int enable)
+/*
+ * The virtual color is expressed in RGB888 format, the alpha component is set
+ * by the alpha component control.
+ */
+static const struct v4l2_ctrl_config rpf_ctrl_virtual_color = {
+	.ops = &rpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_RPF_VIRTUAL_COLOR,
+	.name = "Virtual Color",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 0,
+	.max = 0xffffff,
+	.step = 1,
+	.def = 0,
+};
+
+/*
+ * The palette control holds the 256 entries looked up by the indexed formats,
+ * expressed as 0xAARRGGBB or 0xAAYYUUVV depending on the format. The palette
+ * can be modified while streaming, the new palette is used starting at the
+ * next job.
+ */
+static const struct v4l2_ctrl_config rpf_ctrl_palette = {
+	.ops = &rpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_RPF_PALETTE,
+	.name = "Palette",
+	.type = V4L2_CTRL_TYPE_U32,
+	.min = 0x00000000,
+	.max = 0xffffffff,
+	.step = 1,
+	.def = 0,
+	.dims = { RPF_CLUT_SIZE },
+};
+
+/*
+ * The key color is expressed in RGB888 or YUV888 format depending on the input
+ * format. Matching pixels are made fully transparent when the key is enabled.
+ */
+static const struct v4l2_ctrl_config rpf_ctrl_ckey_enable = {
+	.ops = &rpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_RPF_CKEY_ENABLE,
+	.name = "Color Key Enable",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.min = 0,
+	.max = 1,
+	.step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config rpf_ctrl_ckey_color = {
+	.ops = &rpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_RPF_CKEY_COLOR,
+	.name = "Color Key",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 0,
+	.max = 0xffffff,
+	.step = 1,
+	.def = 0,
+};
+
+/*
+ * vsp2_rpf_set_alpha - Set the RPF fixed alpha value
+ * @rpf: the RPF
+ * @alpha: the alpha value
+ *
+ * Must be called with the pipeline streaming.
+ */
+void vsp2_rpf_set_alpha(struct vsp2_rwpf *rpf, unsigned int alpha)
+{
+	struct vsp2_pipeline *pipe = to_vsp2_pipeline(&rpf->entity.subdev.entity);
+	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
+
+	if (vsp_in == NULL)
+		return;
+
+	vsp_in->alpha_blend->afix = alpha;
+	vsp_in->vircolor = rpf_vircolor(rpf, alpha);
+
+	vsp2_pipeline_propagate_alpha(pipe, &rpf->entity, alpha);
+	rpf->alpha = alpha;
+}
+
+/*
+ * rpf_setup_format - Program the memory format of the RPF input
+ * @rpf: the RPF
+ * @vsp_in: the RPF VSPM input parameters
+ */
+static void rpf_setup_format(struct vsp2_rwpf *rpf, T_VSP_IN *vsp_in)
 {
-	struct vsp2_rwpf *rpf = to_rwpf(subdev);
 	const struct vsp2_format_info *fmtinfo = rpf->video.fmtinfo;
 	const struct v4l2_pix_format_mplane *format = &rpf->video.format;
-	const struct v4l2_rect *crop = &rpf->crop;
-	struct vsp2_pipeline *pipe;
+	unsigned int planes = rpf_color_planes(rpf);
 	u32 infmt;
-	int ret;
 	u32 stride_y = 0;
 	u32 stride_c = 0;
-	u32 height = 0;
-	VSPM_VSP_PAR *vsp_par =
-		rpf->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
-	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
 	u16 vspm_format;
 
-	if (vsp_in == NULL) {
-		dev_err(rpf->entity.vsp2->dev,
-			"failed to rpf stream. Invalid RPF index.\n");
-		return -EINVAL;
-	}
-
-	ret = vsp2_entity_set_streaming(&rpf->entity, enable);
-	if (ret < 0)
-		return ret;
-
-	if (!enable)
-		return 0;
-
-	/* Source size, stride and crop offsets.
-	 *
-	 * The crop offsets correspond to the location of the crop rectangle top
-	 * left corner in the plane buffer. Only two offsets are needed, as
-	 * planes 2 and 3 always have identical strides.
+	/* Source stride. The source size, crop offsets, position and alpha
+	 * plane address are computed for every job by vsp2_rpf_configure().
 	 */
 	stride_y = format->plane_fmt[0].bytesperline;
-	height = crop->height;
-	if (format->num_planes > 1)
+	if (planes > 1)
 		stride_c = format->plane_fmt[1].bytesperline;
 
-	vsp_in->width		= crop->width;
-	vsp_in->height		= crop->height;
-	vsp_in->width_ex	= crop->width;
-	vsp_in->height_ex	= crop->height;
-
 	vsp_in->x_offset	= 0;
 	vsp_in->y_offset	= 0;
 
-	rpf->offsets[0] = crop->top * stride_y
-			+ crop->left * fmtinfo->bpp[0] / 8;
-
-	if (format->num_planes > 1) {
-		rpf->offsets[1] = crop->top * stride_c / fmtinfo->vsub
-				+ crop->left * fmtinfo->bpp[1] / fmtinfo->hsub
-				/ 8;
-	} else {
-		rpf->offsets[1] = 0;
-	}
-
-	vsp_in->addr = (void *)((unsigned long)rpf->buf_addr[0]
-					     + rpf->offsets[0]);
-	vsp_in->addr_c0 = (void *)((unsigned long)rpf->buf_addr[1]
-						 + rpf->offsets[1]);
-	vsp_in->addr_c1 = (void *)((unsigned long)rpf->buf_addr[2]
-						 + rpf->offsets[1]);
-
 	vsp_in->stride		= stride_y;
 	vsp_in->stride_c	= stride_c;
 
@@ -222,6 +348,7 @@ static int rpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	    rpf->entity.formats[RWPF_PAD_SOURCE].code)
 		infmt |= VI6_RPF_INFMT_CSC;
 	infmt |= VI6_RPF_INFMT_CEXT_EXT;
+	infmt |= vsp2_rwpf_ycbcr_encoding(rpf);
 
 	vspm_format = (unsigned short)(infmt & 0x007F);
 	if ((vspm_format == 0x007F) || (vspm_format == 0x003F)) {
@@ -246,15 +373,101 @@ static int rpf_s_stream(struct v4l2_subdev *subdev, int enable)
 
 	vsp_in->swap		= fmtinfo->swap;
 
-	vsp_in->x_position	= rpf->location.left;
-	vsp_in->y_position	= rpf->location.top;
+	/* The alpha component is read from the pixels, from the external
+	 * alpha plane, or set to the fixed alpha value.
+	 */
+	if (fmtinfo->alpha_plane) {
+		vsp_in->alpha_blend->asel = VSP_ALPHA_NUM2;
+		vsp_in->alpha_blend->astride =
+			format->plane_fmt[planes].bytesperline;
+		vsp_in->alpha_blend->aswap = RPF_ALPHA_PLANE_SWAP;
+	} else {
+		vsp_in->alpha_blend->asel = fmtinfo->alpha ?
+					VSP_ALPHA_NUM1 : VSP_ALPHA_NUM5;
+		vsp_in->alpha_blend->astride = 0;
+		vsp_in->alpha_blend->aswap = VSP_SWAP_NO;
+	}
+}
+
+/*
+ * vsp2_rpf_set_format - Apply a new memory format while streaming
+ * @rpf: the RPF
+ *
+ * The video node format has been changed to a new resolution with the same
+ * media bus code. Update the sink and source pad formats, reset the crop
+ * rectangle to the full image and reprogram the input format.
+ */
+void vsp2_rpf_set_format(struct vsp2_rwpf *rpf)
+{
+	const struct v4l2_pix_format_mplane *format = &rpf->video.format;
+	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
+
+	if (vsp_in == NULL)
+		return;
+
+	rpf->entity.formats[RWPF_PAD_SINK].width = format->width;
+	rpf->entity.formats[RWPF_PAD_SINK].height = format->height;
+	rpf->entity.formats[RWPF_PAD_SOURCE].width = format->width;
+	rpf->entity.formats[RWPF_PAD_SOURCE].height = format->height;
 
+	rpf->crop.left = 0;
+	rpf->crop.top = 0;
+	rpf->crop.width = format->width;
+	rpf->crop.height = format->height;
+
+	rpf_setup_format(rpf, vsp_in);
+}
+
+/* -----------------------------------------------------------------------------
+ * V4L2 Subdevice Core Operations
+ */
+
+static int rpf_s_stream(struct v4l2_subdev *subdev, int enable)
+{
+	struct vsp2_rwpf *rpf = to_rwpf(subdev);
+	struct vsp2_pipeline *pipe;
+	int ret;
+	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
+
+	if (vsp_in == NULL) {
+		dev_err(rpf->entity.vsp2->dev,
+			"failed to rpf stream. Invalid RPF index.\n");
+		return -EINVAL;
+	}
+
+	ret = vsp2_entity_set_streaming(&rpf->entity, enable);
+	if (ret < 0)
+		return ret;
+
+	if (!enable)
+		return 0;
+
+	rpf_setup_format(rpf, vsp_in);
+
+	/* A virtual RPF outputs a solid color layer of the crop rectangle size
+	 * without reading memory.
+	 */
 	vsp_in->pwd		= VSP_LAYER_CHILD;
-	vsp_in->vir		= VSP_NO_VIR;
-	vsp_in->vircolor	= 0;
+	vsp_in->vir		= rpf->virtual ? VSP_VIR : VSP_NO_VIR;
+	vsp_in->vircolor	= rpf_vircolor(rpf, rpf->alpha);
 
 	vsp_in->alpha_blend->afix = rpf->alpha;
 
+	/* The palette is copied to the display list by vsp2_rpf_configure()
+	 * for every job.
+	 */
+	if (rpf->video.fmtinfo->clut && !rpf->virtual) {
+		T_VSP_OSDLUT *osd_lut =
+			rpf->entity.vsp2->vspm->osd_lut[rpf->entity.index];
+
+		osd_lut->clut.hard_addr = (void *)(unsigned long)rpf->clut_dma;
+		osd_lut->clut.virt_addr = rpf->clut;
+		osd_lut->clut.tbl_num = RPF_CLUT_SIZE;
+		vsp_in->osd_lut = osd_lut;
+	} else {
+		vsp_in->osd_lut = NULL;
+	}
+
 	pipe = to_vsp2_pipeline(&rpf->entity.subdev.entity);
 	vsp2_pipeline_propagate_alpha(pipe, &rpf->entity, rpf->alpha);
 
@@ -262,27 +475,115 @@ static int rpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	vsp_in->alpha_blend->alphan = VSP_ALPHA_NO;
 	vsp_in->alpha_blend->alpha1 = 0;
 	vsp_in->alpha_blend->alpha2 = 0;
-	vsp_in->alpha_blend->astride = 0;
-	vsp_in->alpha_blend->aswap = VSP_SWAP_NO;
-	vsp_in->alpha_blend->asel = fmtinfo->alpha ?
-					VSP_ALPHA_NUM1 : VSP_ALPHA_NUM5;
 	vsp_in->alpha_blend->aext = VSP_AEXT_COPY;
 	vsp_in->alpha_blend->anum0 = 0;
 	vsp_in->alpha_blend->anum1 = 0;
 	vsp_in->alpha_blend->irop = VSP_IROP_NOP;
-	vsp_in->alpha_blend->msken = VSP_MSKEN_ALPHA;
 	vsp_in->alpha_blend->bsel = 0;
-	vsp_in->alpha_blend->mgcolor = 0;
-	vsp_in->alpha_blend->mscolor0 = 0;
-	vsp_in->alpha_blend->mscolor1 = 0;
-
-	/* Count rpf_num. */
-	if (vsp_par->rpf_num < rpf->entity.index + 1)
-		vsp_par->rpf_num = rpf->entity.index + 1;
+	rpf_set_color_key(rpf, vsp_in);
 
 	return 0;
 }
 
+/*
+ * vsp2_rpf_configure - Configure the RPF geometry for the next job
+ * @rpf: the RPF
+ * @slot: the VSPM source slot the RPF is assigned to for the job
+ * @crop: the part of the input image to be read
+ * @left: horizontal position of the input in the composed image
+ * @top: vertical position of the input in the composed image
+ *
+ * The crop offsets correspond to the location of the crop rectangle top left
+ * corner in the plane buffer. Only two offsets are needed, as planes 2 and 3
+ * always have identical strides. The external alpha plane, if any, has no
+ * subsampling and its offset is computed separately.
+ *
+ * For indexed formats the palette is copied to the display list when it has
+ * been modified, and the CLUT table addresses are rewritten when the input
+ * moves to another source slot. The jobs are serialized, the display list
+ * isn't in use by the VSPM when the next job is configured.
+ */
+void vsp2_rpf_configure(struct vsp2_rwpf *rpf, unsigned int slot,
+			const struct v4l2_rect *crop, unsigned int left,
+			unsigned int top)
+{
+	const struct vsp2_format_info *fmtinfo = rpf->video.fmtinfo;
+	const struct v4l2_pix_format_mplane *format = &rpf->video.format;
+	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
+	unsigned long flags;
+	unsigned int planes;
+	unsigned int i;
+
+	if (vsp_in == NULL)
+		return;
+
+	vsp_in->width		= crop->width;
+	vsp_in->height		= crop->height;
+	vsp_in->width_ex	= crop->width;
+	vsp_in->height_ex	= crop->height;
+
+	vsp_in->x_position	= left;
+	vsp_in->y_position	= top;
+
+	if (rpf->virtual) {
+		vsp_in->addr = NULL;
+		vsp_in->addr_c0 = NULL;
+		vsp_in->addr_c1 = NULL;
+		vsp_in->alpha_blend->addr_a = NULL;
+		return;
+	}
+
+	if (fmtinfo->clut) {
+		if (slot != rpf->clut_slot)
+			rpf_set_clut_slot(rpf, slot);
+
+		spin_lock_irqsave(&rpf->palette_lock, flags);
+
+		if (rpf->palette_dirty) {
+			for (i = 0; i < RPF_CLUT_SIZE; ++i)
+				rpf->clut[i].data = rpf->palette[i];
+
+			rpf->palette_dirty = false;
+		}
+
+		spin_unlock_irqrestore(&rpf->palette_lock, flags);
+	}
+
+	planes = rpf_color_planes(rpf);
+
+	rpf->offsets[0] = crop->top * format->plane_fmt[0].bytesperline
+			+ crop->left * fmtinfo->bpp[0] / 8;
+
+	if (planes > 1) {
+		rpf->offsets[1] = crop->top * format->plane_fmt[1].bytesperline
+				/ fmtinfo->vsub
+				+ crop->left * fmtinfo->bpp[1] / fmtinfo->hsub
+				/ 8;
+	} else {
+		rpf->offsets[1] = 0;
+	}
+
+	vsp_in->addr = (void *)((unsigned long)rpf->buf_addr[0]
+					     + rpf->offsets[0]);
+	vsp_in->addr_c0 = NULL;
+	vsp_in->addr_c1 = NULL;
+	if (planes > 1)
+		vsp_in->addr_c0 = (void *)((unsigned long)rpf->buf_addr[1]
+						     + rpf->offsets[1]);
+	if (planes > 2)
+		vsp_in->addr_c1 = (void *)((unsigned long)rpf->buf_addr[2]
+						     + rpf->offsets[1]);
+
+	if (fmtinfo->alpha_plane)
+		vsp_in->alpha_blend->addr_a =
+			(void *)((unsigned long)rpf->buf_addr[planes]
+				 + crop->top
+				 * format->plane_fmt[planes].bytesperline
+				 + crop->left);
+	else
+		vsp_in->alpha_blend->addr_a = NULL;
+}
+
 /* -----------------------------------------------------------------------------
  * V4L2 Subdevice Operations
  */
@@ -313,26 +614,13 @@ static void rpf_vdev_queue(struct vsp2_video *video,
 			   struct vsp2_video_buffer *buf)
 {
 	struct vsp2_rwpf *rpf = container_of(video, struct vsp2_rwpf, video);
-	T_VSP_IN *vsp_in = rpf_get_vsp_in(rpf);
 	unsigned int i;
 
-	if (vsp_in == NULL) {
-		dev_err(rpf->entity.vsp2->dev,
-			"failed to rpf queue. Invalid RPF index.\n");
-		return;
-	}
-
+	/* The buffer addresses are programmed by vsp2_rpf_configure() when
+	 * the next job is built.
+	 */
 	for (i = 0; i < 3; ++i)
 		rpf->buf_addr[i] = buf->addr[i];
-
-	if (!vsp2_entity_is_streaming(&rpf->entity))
-		return;
-
-	vsp_in->addr = (void *)((unsigned long)buf->addr[0] + rpf->offsets[0]);
-	vsp_in->addr_c0 =
-		(void *)((unsigned long)buf->addr[1] + rpf->offsets[1]);
-	vsp_in->addr_c1 =
-		(void *)((unsigned long)buf->addr[2] + rpf->offsets[1]);
 }
 
 static const struct vsp2_video_operations rpf_vdev_ops = {
@@ -354,6 +642,17 @@ struct vsp2_rwpf *vsp2_rpf_create(struct vsp2_device *vsp2, unsigned int index)
 	if (rpf == NULL)
 		return ERR_PTR(-ENOMEM);
 
+	spin_lock_init(&rpf->palette_lock);
+
+	/* The palette display list holds one register write per entry. */
+	rpf->clut = dmam_alloc_coherent(vsp2->dev,
+					RPF_CLUT_SIZE * sizeof(*rpf->clut),
+					&rpf->clut_dma, GFP_KERNEL);
+	if (rpf->clut == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	rpf_set_clut_slot(rpf, index);
+
 	rpf->max_width = RPF_MAX_WIDTH;
 	rpf->max_height = RPF_MAX_HEIGHT;
 
@@ -377,10 +676,18 @@ struct vsp2_rwpf *vsp2_rpf_create(struct vsp2_device *vsp2, unsigned int index)
 
 	vsp2_entity_init_formats(subdev, NULL);
 
-	/* Initialize the control handler. */
-	v4l2_ctrl_handler_init(&rpf->ctrls, 1);
+	/* Initialize the control handler. The palette control is set up when
+	 * the stream starts, which fills the palette display list.
+	 */
+	v4l2_ctrl_handler_init(&rpf->ctrls, 6);
 	v4l2_ctrl_new_std(&rpf->ctrls, &rpf_ctrl_ops, V4L2_CID_ALPHA_COMPONENT,
 			  0, 255, 1, 255);
+	rpf->virtual_ctrl = v4l2_ctrl_new_custom(&rpf->ctrls,
+						 &rpf_ctrl_virtual, NULL);
+	v4l2_ctrl_new_custom(&rpf->ctrls, &rpf_ctrl_virtual_color, NULL);
+	v4l2_ctrl_new_custom(&rpf->ctrls, &rpf_ctrl_palette, NULL);
+	v4l2_ctrl_new_custom(&rpf->ctrls, &rpf_ctrl_ckey_enable, NULL);
+	v4l2_ctrl_new_custom(&rpf->ctrls, &rpf_ctrl_ckey_color, NULL);
 
 	rpf->entity.subdev.ctrl_handler = &rpf->ctrls;
 
@@ -68,6 +68,127 @@
 #define RWPF_MIN_WIDTH				1
 #define RWPF_MIN_HEIGHT				1
 
+/* -----------------------------------------------------------------------------
+ * Color Space
+ */
+
+static bool vsp2_rwpf_is_yuv(struct vsp2_rwpf *rwpf)
+{
+	return !rwpf->virtual &&
+	       rwpf->video.fmtinfo->mbus == V4L2_MBUS_FMT_AYUV8_1X32;
+}
+
+/* YUV inputs not converted by their RPF, composed as YUV data. */
+static bool vsp2_rwpf_is_yuv_input(struct vsp2_rwpf *rpf)
+{
+	return vsp2_rwpf_is_yuv(rpf) &&
+	       rpf->entity.formats[RWPF_PAD_SOURCE].code ==
+	       V4L2_MBUS_FMT_AYUV8_1X32;
+}
+
+/*
+ * vsp2_rwpf_format_encoding - Get the color conversion mode of a memory format
+ * @rwpf: the RPF or WPF
+ *
+ * Return the RPF INFMT RDTM field value corresponding to the Y'CbCr encoding
+ * and quantization range of the video node format. The default encoding is
+ * BT.709 for the Rec. 709 colorspace and BT.601 otherwise, the default range
+ * is full for the JPEG colorspace and limited otherwise. The WPF OUTFMT WRTM
+ * field has the same layout.
+ */
+u32 vsp2_rwpf_format_encoding(struct vsp2_rwpf *rwpf)
+{
+	const struct v4l2_pix_format_mplane *format = &rwpf->video.format;
+	bool bt709;
+	bool full;
+
+	if (format->ycbcr_enc == V4L2_YCBCR_ENC_DEFAULT)
+		bt709 = format->colorspace == V4L2_COLORSPACE_REC709;
+	else
+		bt709 = format->ycbcr_enc == V4L2_YCBCR_ENC_709;
+
+	if (format->quantization == V4L2_QUANTIZATION_DEFAULT)
+		full = format->colorspace == V4L2_COLORSPACE_JPEG;
+	else
+		full = format->quantization == V4L2_QUANTIZATION_FULL_RANGE;
+
+	if (bt709)
+		return full ? VI6_RPF_INFMT_RDTM_BT709_EXT
+			    : VI6_RPF_INFMT_RDTM_BT709;
+	else
+		return full ? VI6_RPF_INFMT_RDTM_BT601_EXT
+			    : VI6_RPF_INFMT_RDTM_BT601;
+}
+
+/*
+ * vsp2_rwpf_ycbcr_encoding - Get the color conversion mode of an RPF or WPF
+ * @rwpf: the RPF or WPF
+ *
+ * The encoding is a property of the YUV side of the conversion. When the
+ * memory format is YUV, use its encoding. Otherwise the RPF or WPF converts
+ * the pipeline from or to YUV data read or written at the other end of the
+ * pipeline: a WPF uses the encoding of the inputs composed as YUV data, which
+ * vsp2_rwpf_check_encodings() requires to match, and an RPF uses the encoding
+ * of the output if it is YUV.
+ *
+ * Return the RPF INFMT RDTM field value, see vsp2_rwpf_format_encoding().
+ */
+u32 vsp2_rwpf_ycbcr_encoding(struct vsp2_rwpf *rwpf)
+{
+	struct vsp2_pipeline *pipe =
+		to_vsp2_pipeline(&rwpf->entity.subdev.entity);
+	unsigned int i;
+
+	if (vsp2_rwpf_is_yuv(rwpf) || pipe == NULL)
+		return vsp2_rwpf_format_encoding(rwpf);
+
+	if (rwpf->entity.type == VSP2_ENTITY_WPF) {
+		for (i = 0; i < pipe->num_inputs; ++i) {
+			if (vsp2_rwpf_is_yuv_input(pipe->inputs[i]))
+				return vsp2_rwpf_format_encoding(
+							pipe->inputs[i]);
+		}
+	} else if (pipe->output && vsp2_rwpf_is_yuv(pipe->output)) {
+		return vsp2_rwpf_format_encoding(pipe->output);
+	}
+
+	return vsp2_rwpf_format_encoding(rwpf);
+}
+
+/*
+ * vsp2_rwpf_check_encodings - Check the encodings of the pipeline inputs
+ * @pipe: the pipeline
+ *
+ * Inputs converted to RGB by their RPF each use their own encoding and can be
+ * mixed freely. Inputs read from YUV memory formats and left in YUV are
+ * composed as YUV data, a single encoding then describes the composed image
+ * and its conversion by the WPF, if any. Those inputs must use the same
+ * encoding.
+ *
+ * Return 0 on success or -EPIPE if the encodings differ.
+ */
+int vsp2_rwpf_check_encodings(struct vsp2_pipeline *pipe)
+{
+	bool found = false;
+	u32 encoding = 0;
+	unsigned int i;
+
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		struct vsp2_rwpf *rpf = pipe->inputs[i];
+
+		if (!vsp2_rwpf_is_yuv_input(rpf))
+			continue;
+
+		if (found && vsp2_rwpf_format_encoding(rpf) != encoding)
+			return -EPIPE;
+
+		encoding = vsp2_rwpf_format_encoding(rpf);
+		found = true;
+	}
+
+	return 0;
+}
+
 /* -----------------------------------------------------------------------------
  * V4L2 Subdevice Pad Operations
  */
@@ -107,8 +228,8 @@ int vsp2_rwpf_enum_frame_size(struct v4l2_subdev *subdev,
 		fse->min_height = RWPF_MIN_HEIGHT;
 		fse->max_height = rwpf->max_height;
 	} else {
-		/* The size on the source pad are fixed and always identical to
-		 * the size on the sink pad.
+		/* The size on the source pad is fixed and always derived from
+		 * the sink pad crop rectangle.
 		 */
 		fse->min_width = format->width;
 		fse->max_width = format->width;
@@ -132,10 +253,57 @@ vsp2_rwpf_get_crop(struct vsp2_rwpf *rwpf, struct v4l2_subdev_fh *fh, u32 which)
 	}
 }
 
+/*
+ * vsp2_rwpf_set_source_size - Propagate the sink crop size to the source pad
+ * @rwpf: the RPF or WPF
+ * @fh: the subdev file handle, for TRY formats
+ * @which: the format to update (V4L2_SUBDEV_FORMAT_TRY or _ACTIVE)
+ * @rotate: the rotation angle in degrees, 0 for the RPFs
+ *
+ * The source pad size is the size of the sink crop rectangle, with the width
+ * and height swapped when the WPF rotates the image by 90 or 270 degrees.
+ *
+ * Controls have no TRY value, the pad operations pass the active rotation for
+ * both TRY and ACTIVE formats. TRY formats thus follow the rotation control
+ * value at the time they are negotiated, and are not updated when the control
+ * changes.
+ */
+void vsp2_rwpf_set_source_size(struct vsp2_rwpf *rwpf,
+			       struct v4l2_subdev_fh *fh, u32 which,
+			       unsigned int rotate)
+{
+	struct v4l2_mbus_framefmt *format;
+	struct v4l2_rect *crop;
+
+	crop = vsp2_rwpf_get_crop(rwpf, fh, which);
+	format = vsp2_entity_get_pad_format(&rwpf->entity, fh, RWPF_PAD_SOURCE,
+					    which);
+
+	if (rotate == 90 || rotate == 270) {
+		format->width = crop->height;
+		format->height = crop->width;
+	} else {
+		format->width = crop->width;
+		format->height = crop->height;
+	}
+}
+
 int vsp2_rwpf_get_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
 			 struct v4l2_subdev_format *fmt)
 {
 	struct vsp2_rwpf *rwpf = to_rwpf(subdev);
+	struct vsp2_pipeline *pipe = to_vsp2_pipeline(&subdev->entity);
+	unsigned long flags;
+
+	/* The active formats of an RPF are updated by the pipeline when it
+	 * switches to a new input format while streaming.
+	 */
+	if (fmt->which == V4L2_SUBDEV_FORMAT_ACTIVE && pipe) {
+		spin_lock_irqsave(&pipe->irqlock, flags);
+		fmt->format = rwpf->entity.formats[fmt->pad];
+		spin_unlock_irqrestore(&pipe->irqlock, flags);
+		return 0;
+	}
 
 	fmt->format = *vsp2_entity_get_pad_format(&rwpf->entity, fh, fmt->pad,
 						  fmt->which);
@@ -188,6 +356,7 @@ int vsp2_rwpf_set_format(struct v4l2_subdev *subdev, struct v4l2_subdev_fh *fh,
 	format = vsp2_entity_get_pad_format(&rwpf->entity, fh, RWPF_PAD_SOURCE,
 					    fmt->which);
 	*format = fmt->format;
+	vsp2_rwpf_set_source_size(rwpf, fh, fmt->which, rwpf->rotate);
 
 	return 0;
 }
@@ -197,30 +366,38 @@ int vsp2_rwpf_get_selection(struct v4l2_subdev *subdev,
 			    struct v4l2_subdev_selection *sel)
 {
 	struct vsp2_rwpf *rwpf = to_rwpf(subdev);
+	struct vsp2_pipeline *pipe = to_vsp2_pipeline(&subdev->entity);
 	struct v4l2_mbus_framefmt *format;
+	unsigned long flags;
 
 	/* Cropping is implemented on the sink pad. */
 	if (sel->pad != RWPF_PAD_SINK)
 		return -EINVAL;
 
-	switch (sel->target) {
-	case V4L2_SEL_TGT_CROP:
-		sel->r = *vsp2_rwpf_get_crop(rwpf, fh, sel->which);
-		break;
+	if (sel->target != V4L2_SEL_TGT_CROP &&
+	    sel->target != V4L2_SEL_TGT_CROP_BOUNDS)
+		return -EINVAL;
+
+	/* The active crop rectangle and format of an RPF are updated by the
+	 * pipeline when it switches to a new input format while streaming.
+	 */
+	if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE && pipe)
+		spin_lock_irqsave(&pipe->irqlock, flags);
 
-	case V4L2_SEL_TGT_CROP_BOUNDS:
+	if (sel->target == V4L2_SEL_TGT_CROP) {
+		sel->r = *vsp2_rwpf_get_crop(rwpf, fh, sel->which);
+	} else {
 		format = vsp2_entity_get_pad_format(&rwpf->entity, fh,
 						    RWPF_PAD_SINK, sel->which);
 		sel->r.left = 0;
 		sel->r.top = 0;
 		sel->r.width = format->width;
 		sel->r.height = format->height;
-		break;
-
-	default:
-		return -EINVAL;
 	}
 
+	if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE && pipe)
+		spin_unlock_irqrestore(&pipe->irqlock, flags);
+
 	return 0;
 }
 
@@ -265,14 +442,25 @@ int vsp2_rwpf_set_selection(struct v4l2_subdev *subdev,
 	sel->r.height = min_t(unsigned int, sel->r.height,
 			      format->height - sel->r.top);
 
+	/* The crop rectangles are read when building each job. The source pad
+	 * format can't be modified while streaming, only the crop rectangle
+	 * position can then be changed, unless the RPF feeds a UDS that
+	 * absorbs the size change by adjusting its scaling ratios. Changes go
+	 * through the pipeline to be checked against the current input format
+	 * and applied to the right frame.
+	 */
+	if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE &&
+	    vsp2_entity_is_streaming(&rwpf->entity)) {
+		struct vsp2_pipeline *pipe = to_vsp2_pipeline(&subdev->entity);
+
+		return vsp2_pipeline_set_crop(pipe, rwpf, &sel->r);
+	}
+
 	crop = vsp2_rwpf_get_crop(rwpf, fh, sel->which);
 	*crop = sel->r;
 
 	/* Propagate the format to the source pad. */
-	format = vsp2_entity_get_pad_format(&rwpf->entity, fh, RWPF_PAD_SOURCE,
-					    sel->which);
-	format->width = crop->width;
-	format->height = crop->height;
+	vsp2_rwpf_set_source_size(rwpf, fh, sel->which, rwpf->rotate);
 
 	return 0;
 }
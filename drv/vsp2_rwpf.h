@@ -62,6 +62,8 @@
 #ifndef __VSP2_RWPF_H__
 #define __VSP2_RWPF_H__
 
+#include <linux/spinlock.h>
+
 #include <media/media-entity.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-subdev.h>
@@ -73,6 +75,12 @@
 #define RWPF_PAD_SINK				0
 #define RWPF_PAD_SOURCE				1
 
+#define WPF_NUM_PRESETS				4
+
+#define RPF_CLUT_SIZE				256
+
+struct vsp2_lut_entry;
+
 struct vsp2_rwpf {
 	struct vsp2_entity entity;
 	struct vsp2_video video;
@@ -89,6 +97,45 @@ struct vsp2_rwpf {
 
 	unsigned int alpha;
 
+	struct v4l2_ctrl *virtual_ctrl;
+	bool virtual;
+	u32 vircolor;
+
+	spinlock_t palette_lock;
+	u32 palette[RPF_CLUT_SIZE];
+	bool palette_dirty;
+	struct vsp2_lut_entry *clut;
+	dma_addr_t clut_dma;
+	unsigned int clut_slot;
+
+	bool ckey_enable;
+	u32 ckey_color;
+
+	struct v4l2_ctrl *rotate_ctrl;
+	unsigned int rotate;
+	bool hflip;
+	bool vflip;
+	unsigned char rotation;
+
+	struct v4l2_ctrl *damage_ctrls[4];
+	struct v4l2_rect damage;
+
+	bool skip_redundant;
+	bool request_mode;
+	const struct vsp2_pipeline_params *params;
+
+	unsigned int preset;
+	unsigned int presets_valid;
+	struct vsp2_pipeline_params presets[WPF_NUM_PRESETS];
+
+	struct v4l2_ctrl *timing_ctrls[3];
+	struct {
+		unsigned int sequence;
+		s64 start;
+		s64 end;
+		unsigned int skipped;
+	} timing;
+
 	unsigned int offsets[2];
 	dma_addr_t buf_addr[3];
 };
@@ -101,6 +148,20 @@ static inline struct vsp2_rwpf *to_rwpf(struct v4l2_subdev *subdev)
 struct vsp2_rwpf *vsp2_rpf_create(struct vsp2_device *vsp2, unsigned int index);
 struct vsp2_rwpf *vsp2_wpf_create(struct vsp2_device *vsp2, unsigned int index);
 
+void vsp2_rpf_configure(struct vsp2_rwpf *rpf, unsigned int slot,
+			const struct v4l2_rect *crop, unsigned int left,
+			unsigned int top);
+void vsp2_wpf_configure(struct vsp2_rwpf *wpf, const struct v4l2_rect *window);
+void vsp2_rpf_set_alpha(struct vsp2_rwpf *rpf, unsigned int alpha);
+void vsp2_rpf_set_format(struct vsp2_rwpf *rpf);
+
+u32 vsp2_rwpf_format_encoding(struct vsp2_rwpf *rwpf);
+u32 vsp2_rwpf_ycbcr_encoding(struct vsp2_rwpf *rwpf);
+int vsp2_rwpf_check_encodings(struct vsp2_pipeline *pipe);
+void vsp2_rwpf_set_source_size(struct vsp2_rwpf *rwpf,
+			       struct v4l2_subdev_fh *fh, u32 which,
+			       unsigned int rotate);
+
 int vsp2_rwpf_enum_mbus_code(struct v4l2_subdev *subdev,
 			     struct v4l2_subdev_fh *fh,
 			     struct v4l2_subdev_mbus_code_enum *code);
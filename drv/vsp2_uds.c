@@ -133,6 +133,80 @@ static unsigned int uds_compute_ratio(unsigned int input, unsigned int output)
 	return (input - 1) * 4096 / (output - 1);
 }
 
+/*
+ * vsp2_uds_input_supported - Check whether an input size can be scaled
+ * @uds: the UDS
+ * @width: input width in pixels
+ * @height: input height in pixels
+ *
+ * Return true if the input size can be scaled to the UDS source pad format
+ * size within the scaling ratio limits, or false otherwise.
+ */
+bool vsp2_uds_input_supported(struct vsp2_uds *uds, unsigned int width,
+			      unsigned int height)
+{
+	const struct v4l2_mbus_framefmt *output =
+		&uds->entity.formats[UDS_PAD_SOURCE];
+	unsigned int minimum;
+	unsigned int maximum;
+
+	if (width < UDS_IN_MIN_SIZE || width > UDS_IN_MAX_SIZE ||
+	    height < UDS_IN_MIN_SIZE || height > UDS_IN_MAX_SIZE)
+		return false;
+
+	uds_output_limits(width, &minimum, &maximum);
+	if (output->width < minimum || output->width > maximum)
+		return false;
+
+	uds_output_limits(height, &minimum, &maximum);
+	if (output->height < minimum || output->height > maximum)
+		return false;
+
+	return true;
+}
+
+/*
+ * vsp2_uds_configure - Configure the scaling ratios for the next job
+ * @uds: the UDS
+ * @input: the input size for the job, or NULL to use the sink pad format
+ *
+ * The output size is always the source pad format size. The input size
+ * changes when the crop rectangle of the RPF feeding the UDS is modified while
+ * streaming, which implements digital zoom.
+ */
+void vsp2_uds_configure(struct vsp2_uds *uds, const struct v4l2_rect *input)
+{
+	const struct v4l2_mbus_framefmt *output;
+	unsigned int width;
+	unsigned int height;
+	unsigned int hscale;
+	unsigned int vscale;
+	VSPM_VSP_PAR *vsp_par =
+		uds->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_UDS *vsp_uds = vsp_par->ctrl_par->uds;
+
+	output = &uds->entity.formats[UDS_PAD_SOURCE];
+
+	if (input) {
+		width = input->width;
+		height = input->height;
+	} else {
+		width = uds->entity.formats[UDS_PAD_SINK].width;
+		height = uds->entity.formats[UDS_PAD_SINK].height;
+	}
+
+	hscale = uds_compute_ratio(width, output->width);
+	vscale = uds_compute_ratio(height, output->height);
+
+	/* Set the scaling ratios and the output size. */
+	vsp_uds->x_ratio	= clamp_t(unsigned int, hscale, UDS_MIN_FACTOR,
+					  UDS_MAX_FACTOR);
+	vsp_uds->y_ratio	= clamp_t(unsigned int, vscale, UDS_MIN_FACTOR,
+					  UDS_MAX_FACTOR);
+	vsp_uds->out_cwidth	= output->width;
+	vsp_uds->out_cheight	= output->height;
+}
+
 /* -----------------------------------------------------------------------------
  * V4L2 Subdevice Core Operations
  */
@@ -140,10 +214,6 @@ static unsigned int uds_compute_ratio(unsigned int input, unsigned int output)
 static int uds_s_stream(struct v4l2_subdev *subdev, int enable)
 {
 	struct vsp2_uds *uds = to_uds(subdev);
-	const struct v4l2_mbus_framefmt *output;
-	const struct v4l2_mbus_framefmt *input;
-	unsigned int hscale;
-	unsigned int vscale;
 	bool multitap;
 	VSPM_VSP_PAR *vsp_par =
 		uds->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
@@ -152,14 +222,6 @@ static int uds_s_stream(struct v4l2_subdev *subdev, int enable)
 	if (!enable)
 		return 0;
 
-	input = &uds->entity.formats[UDS_PAD_SINK];
-	output = &uds->entity.formats[UDS_PAD_SOURCE];
-
-	hscale = uds_compute_ratio(input->width, output->width);
-	vscale = uds_compute_ratio(input->height, output->height);
-
-	dev_dbg(uds->entity.vsp2->dev, "hscale %u vscale %u\n", hscale, vscale);
-
 	/* Multi-tap scaling can't be enabled along with alpha scaling.
 	 */
 	if (uds->scale_alpha)
@@ -173,12 +235,9 @@ static int uds_s_stream(struct v4l2_subdev *subdev, int enable)
 	vsp_uds->alpha = uds->scale_alpha ? VSP_ALPHA_ON : VSP_ALPHA_OFF;
 	vsp_uds->complement = multitap ? VSP_COMPLEMENT_BC : VSP_COMPLEMENT_BIL;
 
-	/* Set the scaling ratios and the output size. */
-	vsp_uds->x_ratio	= hscale;
-	vsp_uds->y_ratio	= vscale;
-	vsp_uds->out_cwidth	= output->width;
-	vsp_uds->out_cheight	= output->height;
-
+	/* The scaling ratios and the output size are computed for every job by
+	 * vsp2_uds_configure().
+	 */
 	vsp_uds->athres0	= 0;
 	vsp_uds->athres1	= 0;
 	vsp_uds->filcolor	= 0;
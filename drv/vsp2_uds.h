@@ -85,5 +85,8 @@ static inline struct vsp2_uds *to_uds(struct v4l2_subdev *subdev)
 struct vsp2_uds *vsp2_uds_create(struct vsp2_device *vsp2, unsigned int index);
 
 void vsp2_uds_set_alpha(struct vsp2_uds *uds, unsigned int alpha);
+bool vsp2_uds_input_supported(struct vsp2_uds *uds, unsigned int width,
+			      unsigned int height);
+void vsp2_uds_configure(struct vsp2_uds *uds, const struct v4l2_rect *input);
 
 #endif /* __VSP2_UDS_H__ */
@@ -69,6 +69,7 @@
 
 #include <media/media-entity.h>
 #include <media/v4l2-dev.h>
+#include <media/v4l2-event.h>
 #include <media/v4l2-fh.h>
 #include <media/v4l2-ioctl.h>
 #include <media/v4l2-subdev.h>
@@ -77,8 +78,15 @@
 
 #include "vsp2.h"
 #include "vsp2_bru.h"
+#include "vsp2_clu.h"
 #include "vsp2_entity.h"
+#include "vsp2_hgo.h"
+#include "vsp2_hgt.h"
+#include "vsp2_histo.h"
+#include "vsp2_hst.h"
+#include "vsp2_lut.h"
 #include "vsp2_rwpf.h"
+#include "vsp2_sru.h"
 #include "vsp2_uds.h"
 #include "vsp2_video.h"
 #include "vsp2_vspm.h"
@@ -92,6 +100,11 @@
 #define VSP2_VIDEO_MIN_HEIGHT		2U
 #define VSP2_VIDEO_MAX_HEIGHT		8190U
 
+#define VSP2_VIDEO_BUF_COPY_FLAGS	(V4L2_BUF_FLAG_TIMECODE | \
+					 V4L2_BUF_FLAG_KEYFRAME | \
+					 V4L2_BUF_FLAG_PFRAME | \
+					 V4L2_BUF_FLAG_BFRAME)
+
 /* -----------------------------------------------------------------------------
  * Helper functions
  */
@@ -182,6 +195,30 @@ static const struct vsp2_format_info vsp2_video_formats[] = {
 	{ V4L2_PIX_FMT_RGB32S, V4L2_MBUS_FMT_ARGB8888_1X32,
 	  VI6_FMT_ARGB_8888, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS,
 	  1, { 32, 0, 0 }, false, false, 1, 1, false },
+	{ V4L2_PIX_FMT_VSP2_RGB565_A8, V4L2_MBUS_FMT_ARGB8888_1X32,
+	  VI6_FMT_RGB_565, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS,
+	  2, { 16, 8, 0 }, false, false, 1, 1, true, true },
+	{ V4L2_PIX_FMT_VSP2_RGB24_A8, V4L2_MBUS_FMT_ARGB8888_1X32,
+	  VI6_FMT_RGB_888, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS,
+	  2, { 24, 8, 0 }, false, false, 1, 1, true, true },
+	{ V4L2_PIX_FMT_VSP2_XRGB32_A8, V4L2_MBUS_FMT_ARGB8888_1X32,
+	  VI6_FMT_ARGB_8888, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS,
+	  2, { 32, 8, 0 }, false, false, 1, 1, true, true },
+	{ V4L2_PIX_FMT_VSP2_NV12M_A8, V4L2_MBUS_FMT_AYUV8_1X32,
+	  VI6_FMT_Y_UV_420, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS,
+	  3, { 8, 16, 8 }, false, false, 2, 2, true, true },
+	{ V4L2_PIX_FMT_PAL8, V4L2_MBUS_FMT_ARGB8888_1X32,
+	  VI6_FMT_RGB_CLUT8, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS,
+	  1, { 8, 0, 0 }, false, false, 1, 1, true, false, true },
+	{ V4L2_PIX_FMT_VSP2_YUV_PAL8, V4L2_MBUS_FMT_AYUV8_1X32,
+	  VI6_FMT_YUV_CLUT8, VI6_RPF_DSWAP_P_LLS | VI6_RPF_DSWAP_P_LWS |
+	  VI6_RPF_DSWAP_P_WDS | VI6_RPF_DSWAP_P_BTS,
+	  1, { 8, 0, 0 }, false, false, 1, 1, true, false, true },
 };
 
 /*
@@ -259,6 +296,7 @@ static int __vsp2_video_try_format(struct vsp2_video *video,
 	const struct vsp2_format_info *info;
 	unsigned int width = pix->width;
 	unsigned int height = pix->height;
+	unsigned int planes;
 	unsigned int i;
 
 	/* Backward compatibility: replace deprecated RGB formats by their XRGB
@@ -279,11 +317,41 @@ static int __vsp2_video_try_format(struct vsp2_video *video,
 	if (info == NULL)
 		info = vsp2_get_format_info(VSP2_VIDEO_DEF_FORMAT);
 
+	/* External alpha planes and indexed formats can only be read by the
+	 * RPFs.
+	 */
+	if ((info->alpha_plane || info->clut) &&
+	    video->type != V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE)
+		info = vsp2_get_format_info(VSP2_VIDEO_DEF_FORMAT);
+
 	pix->pixelformat = info->fourcc;
-	pix->colorspace = V4L2_COLORSPACE_SRGB;
 	pix->field = V4L2_FIELD_NONE;
 	memset(pix->reserved, 0, sizeof(pix->reserved));
 
+	/* The RPF and WPF color space converters support the BT.601 and BT.709
+	 * encodings in limited or full range, other colorspaces are replaced
+	 * by sRGB. The encoding and range only matter for YUV formats.
+	 */
+	switch (pix->colorspace) {
+	case V4L2_COLORSPACE_SMPTE170M:
+	case V4L2_COLORSPACE_REC709:
+	case V4L2_COLORSPACE_JPEG:
+		break;
+	default:
+		pix->colorspace = V4L2_COLORSPACE_SRGB;
+		break;
+	}
+
+	if (info->mbus != V4L2_MBUS_FMT_AYUV8_1X32 ||
+	    (pix->ycbcr_enc != V4L2_YCBCR_ENC_601 &&
+	     pix->ycbcr_enc != V4L2_YCBCR_ENC_709))
+		pix->ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
+
+	if (info->mbus != V4L2_MBUS_FMT_AYUV8_1X32 ||
+	    (pix->quantization != V4L2_QUANTIZATION_FULL_RANGE &&
+	     pix->quantization != V4L2_QUANTIZATION_LIM_RANGE))
+		pix->quantization = V4L2_QUANTIZATION_DEFAULT;
+
 	/* Align the width and height for YUV 4:2:2 and 4:2:0 formats. */
 	width = round_down(width, info->hsub);
 	height = round_down(height, info->vsub);
@@ -293,7 +361,10 @@ static int __vsp2_video_try_format(struct vsp2_video *video,
 	pix->height = clamp(height, VSP2_VIDEO_MIN_HEIGHT,
 			    VSP2_VIDEO_MAX_HEIGHT);
 
-	for (i = 0; i < min(info->planes, 2U); ++i) {
+	/* The external alpha plane, if any, follows the color planes. */
+	planes = info->planes - (info->alpha_plane ? 1 : 0);
+
+	for (i = 0; i < min(planes, 2U); ++i) {
 		unsigned int hsub = i > 0 ? info->hsub : 1;
 		unsigned int vsub = i > 0 ? info->vsub : 1;
 		unsigned int bpl;
@@ -306,12 +377,21 @@ static int __vsp2_video_try_format(struct vsp2_video *video,
 					    * pix->height / vsub;
 	}
 
-	if (info->planes == 3) {
+	if (planes == 3) {
 		/* The second and third planes must have the same stride. */
 		pix->plane_fmt[2].bytesperline = pix->plane_fmt[1].bytesperline;
 		pix->plane_fmt[2].sizeimage = pix->plane_fmt[1].sizeimage;
 	}
 
+	if (info->alpha_plane) {
+		pix->plane_fmt[planes].bytesperline =
+			clamp_t(unsigned int,
+				pix->plane_fmt[planes].bytesperline,
+				pix->width, 65535U);
+		pix->plane_fmt[planes].sizeimage =
+			pix->plane_fmt[planes].bytesperline * pix->height;
+	}
+
 	pix->num_planes = info->planes;
 
 	if (fmtinfo)
@@ -349,6 +429,985 @@ vsp2_video_format_adjust(struct vsp2_video *video,
 	return true;
 }
 
+/* -----------------------------------------------------------------------------
+ * Job Configuration
+ */
+
+/*
+ * vsp2_pipeline_damage_window - Compute the window composed by the next job
+ * @pipe: the pipeline
+ * @window: the window, in output WPF sink pad coordinates
+ *
+ * The window covers the damage rectangle set on the output WPF, expanded to
+ * even coordinates to satisfy the chroma subsampling constraints. Partial
+ * updates are not supported when the pipeline contains a UDS or an SRU, as the
+ * damage rectangle can't be mapped back to the input images exactly, nor when
+ * it contains an HGO or HGT, as the histograms must cover the whole image, nor
+ * when it feeds the display through the LIF, as the output isn't stored, nor
+ * when the WPF rotates or flips the image.
+ *
+ * Return true if only a window of the output image needs to be composed, or
+ * false if the whole image must be processed.
+ */
+static bool vsp2_pipeline_damage_window(struct vsp2_pipeline *pipe,
+					struct v4l2_rect *window)
+{
+	const struct v4l2_rect *damage = &pipe->output->damage;
+	const struct v4l2_rect *crop = &pipe->output->crop;
+	unsigned int left;
+	unsigned int top;
+	unsigned int right;
+	unsigned int bottom;
+
+	if (pipe->uds || pipe->sru || pipe->hgo || pipe->hgt || pipe->lif ||
+	    pipe->output->rotation != VSP_ROT_OFF ||
+	    damage->width == 0 || damage->height == 0)
+		return false;
+
+	left = round_down(damage->left, 2);
+	top = round_down(damage->top, 2);
+	right = min_t(unsigned int, round_up(damage->left + damage->width, 2),
+		      crop->width);
+	bottom = min_t(unsigned int, round_up(damage->top + damage->height, 2),
+		       crop->height);
+
+	if (left >= right || top >= bottom)
+		return false;
+
+	if (left == 0 && top == 0 && right == crop->width &&
+	    bottom == crop->height)
+		return false;
+
+	window->left = crop->left + left;
+	window->top = crop->top + top;
+	window->width = right - left;
+	window->height = bottom - top;
+
+	return true;
+}
+
+/*
+ * vsp2_pipeline_clip_layer - Clip an input to the composed window
+ * @layer: the layer, with the RPF already set
+ * @window: the composed window
+ *
+ * Return 0 on success, -ENOENT if the input doesn't intersect the window, or
+ * -EINVAL if the clipped input can't be read with the input format
+ * subsampling constraints.
+ */
+static int vsp2_pipeline_clip_layer(struct vsp2_pipeline_layer *layer,
+				    const struct v4l2_rect *window)
+{
+	const struct vsp2_rwpf *rpf = layer->rpf;
+	const struct vsp2_format_info *fmtinfo = rpf->video.fmtinfo;
+	int left = max_t(int, rpf->location.left, window->left);
+	int top = max_t(int, rpf->location.top, window->top);
+	int right = min_t(int, rpf->location.left + rpf->crop.width,
+			  window->left + window->width);
+	int bottom = min_t(int, rpf->location.top + rpf->crop.height,
+			   window->top + window->height);
+
+	if (left >= right || top >= bottom)
+		return -ENOENT;
+
+	layer->crop.left = rpf->crop.left + left - rpf->location.left;
+	layer->crop.top = rpf->crop.top + top - rpf->location.top;
+	layer->crop.width = right - left;
+	layer->crop.height = bottom - top;
+
+	if (layer->crop.left % fmtinfo->hsub ||
+	    layer->crop.width % fmtinfo->hsub ||
+	    layer->crop.top % fmtinfo->vsub ||
+	    layer->crop.height % fmtinfo->vsub)
+		return -EINVAL;
+
+	layer->left = left - window->left;
+	layer->top = top - window->top;
+
+	return 0;
+}
+
+/*
+ * vsp2_pipeline_layer_opaque - Check whether a layer hides the layers below
+ * @bru: the BRU composing the layers
+ * @layer: the layer
+ *
+ * Formats without an alpha channel are blended with the fixed alpha value set
+ * through the RPF alpha control, the layer is opaque when that value is 255.
+ * Virtual RPFs always use the fixed alpha value, regardless of the format.
+ * The layers below remain visible when the layer is blended additively or
+ * with a constant coefficient, or combined with them by a raster operation,
+ * for instance an additive layer over a full screen layer. They also remain
+ * visible through the pixels made transparent by the color key.
+ */
+static bool vsp2_pipeline_layer_opaque(const struct vsp2_bru *bru,
+				       const struct vsp2_pipeline_layer *layer)
+{
+	const struct vsp2_rwpf *rpf = layer->rpf;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+		if (bru->inputs[i].rpf != rpf)
+			continue;
+
+		if (bru->inputs[i].blend != VSP2_BRU_BLEND_ALPHA ||
+		    bru->inputs[i].rop != VI6_ROP_NOP)
+			return false;
+		break;
+	}
+
+	if (rpf->ckey_enable)
+		return false;
+
+	if (rpf->virtual)
+		return rpf->alpha == 255;
+
+	return !rpf->video.fmtinfo->alpha && rpf->alpha == 255;
+}
+
+/*
+ * vsp2_pipeline_occlude_layer - Clip a layer against an opaque layer above it
+ * @layer: the layer to clip
+ * @above: the opaque layer
+ *
+ * The layer is cropped when the opaque layer covers a full band along one of
+ * its edges, as the visible part is then still rectangular. The cropped
+ * amount is rounded down to the layer format subsampling constraints.
+ *
+ * Return true if the layer is entirely hidden, or false otherwise.
+ */
+static bool vsp2_pipeline_occlude_layer(struct vsp2_pipeline_layer *layer,
+					const struct vsp2_pipeline_layer *above)
+{
+	const struct vsp2_format_info *fmtinfo = layer->rpf->video.fmtinfo;
+	int left = layer->left;
+	int top = layer->top;
+	int right = left + layer->crop.width;
+	int bottom = top + layer->crop.height;
+	int o_left = above->left;
+	int o_top = above->top;
+	int o_right = o_left + above->crop.width;
+	int o_bottom = o_top + above->crop.height;
+	unsigned int cut;
+
+	if (o_left <= left && o_right >= right) {
+		if (o_top <= top && o_bottom >= bottom)
+			return true;
+
+		if (o_top <= top && o_bottom > top) {
+			cut = round_down(o_bottom - top, fmtinfo->vsub);
+			layer->top += cut;
+			layer->crop.top += cut;
+			layer->crop.height -= cut;
+		} else if (o_bottom >= bottom && o_top < bottom) {
+			cut = round_down(bottom - o_top, fmtinfo->vsub);
+			layer->crop.height -= cut;
+		}
+	} else if (o_top <= top && o_bottom >= bottom) {
+		if (o_left <= left && o_right > left) {
+			cut = round_down(o_right - left, fmtinfo->hsub);
+			layer->left += cut;
+			layer->crop.left += cut;
+			layer->crop.width -= cut;
+		} else if (o_right >= right && o_left < right) {
+			cut = round_down(right - o_left, fmtinfo->hsub);
+			layer->crop.width -= cut;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * vsp2_pipeline_cull_layers - Remove the hidden parts of the layers
+ * @bru: the BRU composing the layers
+ * @layers: the layers, from bottom to top
+ * @num_layers: the number of layers
+ *
+ * Layers entirely hidden by opaque layers above them are removed, and layers
+ * partly hidden are cropped, to avoid reading pixels that don't contribute
+ * to the composed image. The topmost layer is never removed.
+ *
+ * Return the number of remaining layers.
+ */
+static unsigned int
+vsp2_pipeline_cull_layers(const struct vsp2_bru *bru,
+			  struct vsp2_pipeline_layer *layers,
+			  unsigned int num_layers)
+{
+	unsigned int count = 0;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0; i < num_layers; ++i) {
+		bool hidden = false;
+
+		for (j = i + 1; j < num_layers && !hidden; ++j) {
+			if (!vsp2_pipeline_layer_opaque(bru, &layers[j]))
+				continue;
+
+			hidden = vsp2_pipeline_occlude_layer(&layers[i],
+							     &layers[j]);
+		}
+
+		if (!hidden)
+			layers[count++] = layers[i];
+	}
+
+	return count;
+}
+
+/*
+ * vsp2_pipeline_input_uds - Find the UDS scaling an input
+ * @pipe: the pipeline
+ * @input: the entity feeding the UDS, an RPF or the BRU
+ *
+ * Return the UDS directly fed by @input, or NULL if the input isn't scaled.
+ */
+struct vsp2_uds *vsp2_pipeline_input_uds(struct vsp2_pipeline *pipe,
+					 struct vsp2_entity *input)
+{
+	if (!pipe->uds || pipe->uds_input != input)
+		return NULL;
+
+	return to_uds(&pipe->uds->subdev);
+}
+
+/*
+ * vsp2_pipeline_input_enabled - Check whether an input is used by the jobs
+ * @pipe: the pipeline
+ * @rpf: the input RPF
+ *
+ * BRU inputs can be disabled while streaming, all other inputs are always
+ * enabled.
+ */
+static bool vsp2_pipeline_input_enabled(struct vsp2_pipeline *pipe,
+					struct vsp2_rwpf *rpf)
+{
+	struct vsp2_bru *bru;
+	unsigned int i;
+
+	if (!pipe->bru)
+		return true;
+
+	bru = to_bru(&pipe->bru->subdev);
+
+	for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+		if (bru->inputs[i].rpf == rpf)
+			return bru->inputs[i].enabled;
+	}
+
+	return true;
+}
+
+/*
+ * vsp2_pipeline_buffers_mask - Compute the video nodes used by the next job
+ * @pipe: the pipeline
+ *
+ * Return a mask of the output and enabled input video nodes, indexed by
+ * pipe_index. Virtual inputs don't use buffers.
+ */
+static unsigned int vsp2_pipeline_buffers_mask(struct vsp2_pipeline *pipe)
+{
+	unsigned int mask = pipe->lif ? 0 : 1 << 0;
+	unsigned int i;
+
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		if (!pipe->inputs[i]->virtual &&
+		    vsp2_pipeline_input_enabled(pipe, pipe->inputs[i]))
+			mask |= 1 << pipe->inputs[i]->video.pipe_index;
+	}
+
+	return mask;
+}
+
+/*
+ * vsp2_pipeline_setup_layers - Compute the layers composed by the next job
+ * @pipe: the pipeline
+ * @window: the composed window, or NULL to compose the whole output image
+ * @layers: the layers array to fill, from bottom to top
+ *
+ * Return the number of layers on success or a negative error code if the
+ * window can't be composed.
+ */
+static int vsp2_pipeline_setup_layers(struct vsp2_pipeline *pipe,
+				      const struct v4l2_rect *window,
+				      struct vsp2_pipeline_layer *layers)
+{
+	struct vsp2_rwpf *inputs[VSP2_COUNT_RPF];
+	unsigned int num_inputs = 0;
+	unsigned int num_layers = 0;
+	unsigned int i;
+	int ret;
+
+	if (pipe->bru) {
+		struct vsp2_bru *bru = to_bru(&pipe->bru->subdev);
+		unsigned int zorder[VSP2_COUNT_RPF];
+		unsigned int j;
+
+		/* Stack the BRU inputs by Z-order, keeping the input index
+		 * order for inputs with the same Z-order.
+		 */
+		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+			if (!bru->inputs[i].rpf || !bru->inputs[i].enabled)
+				continue;
+
+			for (j = num_inputs; j > 0; --j) {
+				if (zorder[j - 1] <= bru->inputs[i].zorder)
+					break;
+
+				inputs[j] = inputs[j - 1];
+				zorder[j] = zorder[j - 1];
+			}
+
+			inputs[j] = bru->inputs[i].rpf;
+			zorder[j] = bru->inputs[i].zorder;
+			num_inputs++;
+		}
+	} else {
+		inputs[num_inputs++] = pipe->inputs[0];
+	}
+
+	for (i = 0; i < num_inputs; ++i) {
+		struct vsp2_pipeline_layer *layer = &layers[num_layers];
+
+		layer->rpf = inputs[i];
+
+		if (window == NULL) {
+			layer->crop = inputs[i]->crop;
+			layer->left = inputs[i]->location.left;
+			layer->top = inputs[i]->location.top;
+			num_layers++;
+			continue;
+		}
+
+		ret = vsp2_pipeline_clip_layer(layer, window);
+		if (ret == -ENOENT)
+			continue;
+		if (ret < 0)
+			return ret;
+
+		num_layers++;
+	}
+
+	/* Skip the hidden parts of the BRU inputs. The layers size in the
+	 * composed image differs from their crop size when scaled by a UDS or
+	 * an SRU before the BRU, the coverage can't be computed in that case.
+	 * The HGO and HGT could sample an input before the BRU, all inputs must
+	 * then be read completely.
+	 */
+	if (pipe->bru && !pipe->hgo && !pipe->hgt &&
+	    (!pipe->uds || pipe->uds_input == pipe->bru) &&
+	    (!pipe->sru || pipe->sru_input == pipe->bru))
+		num_layers = vsp2_pipeline_cull_layers(pipe->bru, layers,
+						       num_layers);
+
+	/* The VSPM needs at least one source per job. */
+	if (num_layers == 0)
+		return -EINVAL;
+
+	return num_layers;
+}
+
+/*
+ * vsp2_pipeline_setup_job - Compute the parameters of the next job
+ * @pipe: the pipeline
+ * @job: the job description to fill
+ *
+ * Only the part of the output image covered by the damage rectangle is
+ * composed when possible. The job falls back to composing the whole output
+ * image otherwise. The damage rectangle is consumed by the job.
+ *
+ * Return 0 on success or a negative error code otherwise.
+ */
+static int vsp2_pipeline_setup_job(struct vsp2_pipeline *pipe,
+				   struct vsp2_pipeline_job *job)
+{
+	unsigned int i;
+	int ret = -EINVAL;
+
+	memset(job, 0, sizeof(*job));
+
+	job->partial = vsp2_pipeline_damage_window(pipe, &job->window);
+	memset(&pipe->output->damage, 0, sizeof(pipe->output->damage));
+	if (job->partial)
+		ret = vsp2_pipeline_setup_layers(pipe, &job->window,
+						 job->layers);
+
+	if (ret < 0) {
+		job->partial = false;
+		ret = vsp2_pipeline_setup_layers(pipe, NULL, job->layers);
+		if (ret < 0)
+			return ret;
+	}
+
+	job->num_layers = ret;
+
+	for (i = 0; i < job->num_layers; ++i)
+		memcpy(job->addr[i], job->layers[i].rpf->buf_addr,
+		       sizeof(job->addr[i]));
+
+	memcpy(job->out_addr, pipe->output->buf_addr, sizeof(job->out_addr));
+
+	/* The buffers of hidden layers are consumed as well, only disabled
+	 * inputs keep their buffers.
+	 */
+	job->buffers = vsp2_pipeline_buffers_mask(pipe);
+
+	/* The master input is the bottom-most composed layer read from a
+	 * buffer, its metadata is copied to the output buffer.
+	 */
+	for (i = 0; i < job->num_layers; ++i) {
+		struct vsp2_rwpf *rpf = job->layers[i].rpf;
+
+		if (!rpf->virtual &&
+		    job->buffers & (1 << rpf->video.pipe_index)) {
+			job->master = rpf->video.pipe_index;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * vsp2_pipeline_job_equal - Check whether two jobs produce the same output
+ *
+ * Two jobs are identical if they compose the same layers from the same
+ * buffers with the same geometry into the same output buffer.
+ */
+static bool vsp2_pipeline_job_equal(const struct vsp2_pipeline_job *a,
+				    const struct vsp2_pipeline_job *b)
+{
+	const struct v4l2_rect *ra;
+	const struct v4l2_rect *rb;
+	unsigned int i;
+
+	if (a->num_layers != b->num_layers || a->partial != b->partial)
+		return false;
+
+	if (a->partial &&
+	    (a->window.left != b->window.left ||
+	     a->window.top != b->window.top ||
+	     a->window.width != b->window.width ||
+	     a->window.height != b->window.height))
+		return false;
+
+	for (i = 0; i < a->num_layers; ++i) {
+		ra = &a->layers[i].crop;
+		rb = &b->layers[i].crop;
+
+		if (a->layers[i].rpf != b->layers[i].rpf ||
+		    a->layers[i].left != b->layers[i].left ||
+		    a->layers[i].top != b->layers[i].top ||
+		    ra->left != rb->left || ra->top != rb->top ||
+		    ra->width != rb->width || ra->height != rb->height)
+			return false;
+
+		if (memcmp(a->addr[i], b->addr[i], sizeof(a->addr[i])))
+			return false;
+	}
+
+	return !memcmp(a->out_addr, b->out_addr, sizeof(a->out_addr));
+}
+
+/*
+ * vsp2_pipeline_configure - Configure the pipeline entities for a job
+ * @pipe: the pipeline
+ * @job: the job parameters
+ */
+static void vsp2_pipeline_configure(struct vsp2_pipeline *pipe,
+				    const struct vsp2_pipeline_job *job)
+{
+	struct vsp2_device *vsp2 = pipe->output->entity.vsp2;
+	const struct v4l2_rect *window = job->partial ? &job->window : NULL;
+	unsigned int i;
+
+	/* The inputs are assigned to the VSPM source slots in layer order by
+	 * vsp2_vspm_set_layers().
+	 */
+	for (i = 0; i < job->num_layers; ++i)
+		vsp2_rpf_configure(job->layers[i].rpf, i, &job->layers[i].crop,
+				   job->layers[i].left, job->layers[i].top);
+
+	/* The UDS input size follows the crop rectangle of the RPF feeding
+	 * it, the BRU output size is fixed.
+	 */
+	if (pipe->uds) {
+		const struct v4l2_rect *input = NULL;
+
+		for (i = 0; i < job->num_layers; ++i) {
+			if (&job->layers[i].rpf->entity == pipe->uds_input)
+				input = &job->layers[i].crop;
+		}
+
+		vsp2_uds_configure(to_uds(&pipe->uds->subdev), input);
+	}
+
+	if (pipe->sru)
+		vsp2_sru_configure(to_sru(&pipe->sru->subdev));
+
+	if (pipe->bru)
+		vsp2_bru_configure(to_bru(&pipe->bru->subdev), job->layers,
+				   job->num_layers, window);
+
+	if (pipe->clu)
+		vsp2_clu_configure(to_clu(&pipe->clu->subdev));
+
+	if (pipe->hgo)
+		vsp2_hgo_configure(to_hgo(&pipe->hgo->subdev));
+
+	if (pipe->hgt)
+		vsp2_hgt_configure(to_hgt(&pipe->hgt->subdev));
+
+	if (pipe->lut) {
+		struct vsp2_hsv_adjust adjust;
+
+		if (pipe->lut_hsv)
+			vsp2_hst_get_adjust(to_hst(&pipe->hst->subdev),
+					    &adjust);
+
+		vsp2_lut_configure(to_lut(&pipe->lut->subdev),
+				   pipe->lut_hsv ? &adjust : NULL);
+	}
+
+	vsp2_wpf_configure(pipe->output, window);
+	vsp2_vspm_set_layers(vsp2, job->layers, job->num_layers);
+}
+
+/*
+ * vsp2_pipeline_invalidate_job - Invalidate the last job parameters
+ * @pipe: the pipeline
+ *
+ * Entities must call this function when a parameter not covered by the job
+ * description is modified while streaming, to prevent the next job from being
+ * considered as redundant.
+ */
+void vsp2_pipeline_invalidate_job(struct vsp2_pipeline *pipe)
+{
+	unsigned long flags;
+
+	if (pipe == NULL)
+		return;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+	pipe->job.valid = false;
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+/* -----------------------------------------------------------------------------
+ * Per-Frame Parameters
+ *
+ * The crop and compose rectangles, alpha values and background color can be
+ * modified while streaming. They are applied to the next job by default. When
+ * request mode is enabled on the output WPF, the changes are instead staged in
+ * the pipeline and bound to the next output buffer queued, to be applied
+ * atomically to the job that writes that buffer.
+ *
+ * The damage rectangle only describes the changes made for one job. It is
+ * cleared once consumed by a job, and not stored in the staged parameters
+ * anymore once bound to a buffer. Parameters read back from the pipeline, and
+ * thus the presets, carry no damage rectangle.
+ *
+ * A complete set of parameters can also be stored in a preset on the output
+ * WPF, and switched to later as a whole.
+ */
+
+static bool vsp2_pipeline_staging(struct vsp2_pipeline *pipe)
+{
+	return pipe->params_ready && pipe->output->request_mode;
+}
+
+static void vsp2_pipeline_apply_compose(struct vsp2_bru *bru,
+					unsigned int input,
+					const struct v4l2_rect *compose)
+{
+	struct vsp2_rwpf *rpf = bru->inputs[input].rpf;
+
+	bru->inputs[input].compose = *compose;
+
+	if (rpf) {
+		rpf->location.left = compose->left;
+		rpf->location.top = compose->top;
+	}
+}
+
+static void vsp2_pipeline_apply_params(struct vsp2_pipeline *pipe,
+				       const struct vsp2_pipeline_params *params)
+{
+	unsigned int i;
+
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		struct vsp2_rwpf *rpf = pipe->inputs[i];
+		unsigned int index = rpf->entity.index;
+
+		rpf->crop = params->crop[index];
+		if (rpf->alpha != params->alpha[index])
+			vsp2_rpf_set_alpha(rpf, params->alpha[index]);
+	}
+
+	if (pipe->bru) {
+		struct vsp2_bru *bru = to_bru(&pipe->bru->subdev);
+
+		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+			vsp2_pipeline_apply_compose(bru, i,
+						    &params->compose[i]);
+			bru->inputs[i].enabled = params->enabled[i];
+		}
+
+		if (bru->bgcolor != params->bgcolor)
+			vsp2_bru_set_bgcolor(bru, params->bgcolor);
+	}
+
+	pipe->output->damage = params->damage;
+	pipe->job.valid = false;
+}
+
+static void vsp2_pipeline_get_params(struct vsp2_pipeline *pipe,
+				     struct vsp2_pipeline_params *params)
+{
+	unsigned int i;
+
+	memset(params, 0, sizeof(*params));
+
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		struct vsp2_rwpf *rpf = pipe->inputs[i];
+
+		params->crop[rpf->entity.index] = rpf->crop;
+		params->alpha[rpf->entity.index] = rpf->alpha;
+	}
+
+	if (pipe->bru) {
+		struct vsp2_bru *bru = to_bru(&pipe->bru->subdev);
+
+		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+			params->compose[i] = bru->inputs[i].compose;
+			params->enabled[i] = bru->inputs[i].enabled;
+		}
+
+		params->bgcolor = bru->bgcolor;
+	}
+}
+
+/*
+ * vsp2_pipeline_check_params - Check parameters against the pipeline
+ * @pipe: the pipeline
+ * @params: the parameters
+ *
+ * Parameters stored in a preset might not be applicable to the pipeline
+ * anymore if the formats have been changed since. Only the positions of the
+ * crop and compose rectangles can change while streaming, the crop size can
+ * also change for the RPF feeding the UDS.
+ *
+ * Return 0 if the parameters can be applied or -EINVAL otherwise.
+ */
+static int vsp2_pipeline_check_params(struct vsp2_pipeline *pipe,
+				      const struct vsp2_pipeline_params *params)
+{
+	unsigned int enabled = 0;
+	unsigned int i;
+
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		struct vsp2_rwpf *rpf = pipe->inputs[i];
+		const struct v4l2_rect *crop = &params->crop[rpf->entity.index];
+		const struct v4l2_mbus_framefmt *format =
+			&rpf->entity.formats[RWPF_PAD_SINK];
+		struct vsp2_uds *uds;
+
+		if (crop->left + crop->width > format->width ||
+		    crop->top + crop->height > format->height)
+			return -EINVAL;
+
+		if (crop->width == rpf->crop.width &&
+		    crop->height == rpf->crop.height)
+			continue;
+
+		uds = vsp2_pipeline_input_uds(pipe, &rpf->entity);
+		if (!uds || !vsp2_uds_input_supported(uds, crop->width,
+						      crop->height))
+			return -EINVAL;
+	}
+
+	if (pipe->bru) {
+		struct vsp2_bru *bru = to_bru(&pipe->bru->subdev);
+		const struct v4l2_mbus_framefmt *format =
+			&bru->entity.formats[BRU_PAD_SOURCE];
+
+		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+			const struct v4l2_rect *compose = &params->compose[i];
+
+			if (compose->width != bru->inputs[i].compose.width ||
+			    compose->height != bru->inputs[i].compose.height ||
+			    compose->left >= format->width ||
+			    compose->top >= format->height)
+				return -EINVAL;
+
+			if (!bru->inputs[i].rpf)
+				continue;
+
+			if (params->enabled[i])
+				enabled++;
+			else if (vsp2_pipeline_input_uds(pipe,
+						&bru->inputs[i].rpf->entity))
+				return -EINVAL;
+		}
+
+		if (enabled == 0)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Must be called with the pipeline irqlock held. */
+static void vsp2_pipeline_init_params(struct vsp2_pipeline *pipe)
+{
+	vsp2_pipeline_get_params(pipe, &pipe->pending);
+
+	pipe->pending_dirty = false;
+	pipe->params_ready = true;
+
+	/* The damage controls are restored when the stream starts, but the
+	 * first job must write the whole output image.
+	 */
+	memset(&pipe->output->damage, 0, sizeof(pipe->output->damage));
+}
+
+static void vsp2_pipeline_bind_params(struct vsp2_pipeline *pipe,
+				      struct vsp2_video_buffer *buf)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	buf->has_params = pipe->pending_dirty;
+	if (pipe->pending_dirty)
+		buf->params = pipe->pending;
+
+	memset(&pipe->pending.damage, 0, sizeof(pipe->pending.damage));
+	pipe->pending_dirty = false;
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+/*
+ * vsp2_pipeline_set_crop - Set the crop rectangle of an RPF or WPF
+ * @pipe: the pipeline
+ * @rwpf: the RPF or WPF
+ * @crop: the crop rectangle
+ *
+ * The crop size of an RPF can only change when the RPF feeds a UDS. The input
+ * format can be switched between the time the rectangle is adjusted to the
+ * sink pad format and the time it is set, the rectangle is thus checked again
+ * with the pipeline irqlock held.
+ *
+ * Return 0 on success, -EBUSY if the crop size can't change or the rectangle
+ * doesn't fit in the image anymore, or -ERANGE if the UDS can't scale the new
+ * size.
+ */
+int vsp2_pipeline_set_crop(struct vsp2_pipeline *pipe, struct vsp2_rwpf *rwpf,
+			   const struct v4l2_rect *crop)
+{
+	const struct v4l2_mbus_framefmt *format =
+		&rwpf->entity.formats[RWPF_PAD_SINK];
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (crop->left + crop->width > format->width ||
+	    crop->top + crop->height > format->height) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	if (crop->width != rwpf->crop.width ||
+	    crop->height != rwpf->crop.height) {
+		struct vsp2_uds *uds =
+			vsp2_pipeline_input_uds(pipe, &rwpf->entity);
+
+		if (!uds) {
+			ret = -EBUSY;
+			goto done;
+		}
+
+		if (!vsp2_uds_input_supported(uds, crop->width,
+					      crop->height)) {
+			ret = -ERANGE;
+			goto done;
+		}
+	}
+
+	if (rwpf->entity.type == VSP2_ENTITY_RPF &&
+	    vsp2_pipeline_staging(pipe)) {
+		pipe->pending.crop[rwpf->entity.index] = *crop;
+		pipe->pending_dirty = true;
+	} else {
+		rwpf->crop = *crop;
+	}
+
+done:
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+	return ret;
+}
+
+void vsp2_pipeline_set_alpha(struct vsp2_pipeline *pipe, struct vsp2_rwpf *rpf,
+			     unsigned int alpha)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (vsp2_pipeline_staging(pipe)) {
+		pipe->pending.alpha[rpf->entity.index] = alpha;
+		pipe->pending_dirty = true;
+	} else {
+		vsp2_rpf_set_alpha(rpf, alpha);
+		pipe->job.valid = false;
+	}
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+void vsp2_pipeline_set_compose(struct vsp2_pipeline *pipe, struct vsp2_bru *bru,
+			       unsigned int input,
+			       const struct v4l2_rect *compose)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (vsp2_pipeline_staging(pipe)) {
+		pipe->pending.compose[input] = *compose;
+		pipe->pending_dirty = true;
+	} else {
+		vsp2_pipeline_apply_compose(bru, input, compose);
+	}
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+void vsp2_pipeline_set_bgcolor(struct vsp2_pipeline *pipe, struct vsp2_bru *bru,
+			       u32 bgcolor)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (vsp2_pipeline_staging(pipe)) {
+		pipe->pending.bgcolor = bgcolor;
+		pipe->pending_dirty = true;
+	} else {
+		vsp2_bru_set_bgcolor(bru, bgcolor);
+		pipe->job.valid = false;
+	}
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+void vsp2_pipeline_set_damage(struct vsp2_pipeline *pipe,
+			      const struct v4l2_rect *damage)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (vsp2_pipeline_staging(pipe)) {
+		pipe->pending.damage = *damage;
+		pipe->pending_dirty = true;
+	} else {
+		pipe->output->damage = *damage;
+	}
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+/*
+ * vsp2_pipeline_set_request_mode - Enable or disable request mode
+ * @pipe: the pipeline
+ * @wpf: the pipeline output WPF
+ * @enable: whether to stage the parameters until the next queued buffer
+ *
+ * The parameters modified while request mode was disabled have been applied
+ * directly. When enabling request mode, take a new snapshot of the current
+ * parameters to stage changes from, otherwise binding the next staged change
+ * would revert them.
+ */
+void vsp2_pipeline_set_request_mode(struct vsp2_pipeline *pipe,
+				    struct vsp2_rwpf *wpf, bool enable)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (enable && !wpf->request_mode && pipe->params_ready) {
+		vsp2_pipeline_get_params(pipe, &pipe->pending);
+		pipe->pending_dirty = false;
+	}
+
+	wpf->request_mode = enable;
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+/*
+ * vsp2_pipeline_store_preset - Store the pipeline parameters in a preset
+ * @pipe: the pipeline
+ * @preset: the preset to fill
+ *
+ * The staged parameters are stored in request mode, the current parameters
+ * otherwise.
+ */
+void vsp2_pipeline_store_preset(struct vsp2_pipeline *pipe,
+				struct vsp2_pipeline_params *preset)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	if (vsp2_pipeline_staging(pipe))
+		*preset = pipe->pending;
+	else
+		vsp2_pipeline_get_params(pipe, preset);
+
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+}
+
+/*
+ * vsp2_pipeline_load_preset - Switch the pipeline to a preset
+ * @pipe: the pipeline
+ * @preset: the preset
+ *
+ * The preset replaces all the per-frame parameters at once. It is applied to
+ * the next job, or staged for the next queued output buffer in request mode.
+ *
+ * Return 0 on success or -EINVAL if the preset doesn't match the pipeline
+ * formats.
+ */
+int vsp2_pipeline_load_preset(struct vsp2_pipeline *pipe,
+			      const struct vsp2_pipeline_params *preset)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	ret = vsp2_pipeline_check_params(pipe, preset);
+	if (ret < 0)
+		goto done;
+
+	if (vsp2_pipeline_staging(pipe)) {
+		pipe->pending = *preset;
+		pipe->pending_dirty = true;
+	} else {
+		pipe->preset = preset;
+	}
+
+done:
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+	return ret;
+}
+
 /* -----------------------------------------------------------------------------
  * Pipeline Management
  */
@@ -357,12 +1416,27 @@ static int vsp2_pipeline_validate_branch(struct vsp2_pipeline *pipe,
 					 struct vsp2_rwpf *input,
 					 struct vsp2_rwpf *output)
 {
+	struct media_entity *hgt_source = NULL;
 	struct vsp2_entity *entity;
 	unsigned int entities = 0;
 	struct media_pad *pad;
 	bool bru_found = false;
+	bool uds_found = false;
+	bool hsv = false;
 
-	pad = media_entity_remote_pad(&input->entity.pads[RWPF_PAD_SOURCE]);
+	/* The HGT interprets its input as HSV data, it must sample the output
+	 * of the HST or of an entity processing the HST output.
+	 */
+	if (pipe->hgt) {
+		pad = media_entity_remote_pad(&pipe->hgt->pads[HISTO_PAD_SINK]);
+		if (pad)
+			hgt_source = pad->entity;
+	}
+
+	if (hgt_source == &input->entity.subdev.entity)
+		return -EPIPE;
+
+	pad = vsp2_entity_remote_pad(&input->entity.pads[RWPF_PAD_SOURCE]);
 
 	input->location.left = 0;
 	input->location.top = 0;
@@ -404,23 +1478,50 @@ static int vsp2_pipeline_validate_branch(struct vsp2_pipeline *pipe,
 
 		entities |= 1 << entity->subdev.entity.id;
 
-		/* UDS can't be chained. */
+		/* UDS can't be chained. The VSPM takes a single UDS parameter
+		 * block per job, a pipeline can thus only use one UDS, either
+		 * in one branch or after the BRU where it is shared by all
+		 * branches.
+		 */
 		if (entity->type == VSP2_ENTITY_UDS) {
-			if (pipe->uds)
+			if (uds_found || (pipe->uds && pipe->uds != entity))
 				return -EPIPE;
 
+			uds_found = true;
 			pipe->uds = entity;
 			pipe->uds_input = bru_found ? pipe->bru
 					: &input->entity;
 		}
 
+		/* The LUT applies the HSV adjustments when it processes the
+		 * HSV data output by the HST.
+		 */
+		if (entity->type == VSP2_ENTITY_HST)
+			hsv = true;
+		else if (entity->type == VSP2_ENTITY_HSI)
+			hsv = false;
+		else if (entity->type == VSP2_ENTITY_LUT && hsv)
+			pipe->lut_hsv = true;
+
+		if (hgt_source == &entity->subdev.entity && !hsv)
+			return -EPIPE;
+
+		/* The SRU is shared by all branches when placed after the
+		 * BRU.
+		 */
+		if (entity->type == VSP2_ENTITY_SRU) {
+			pipe->sru = entity;
+			pipe->sru_input = bru_found ? pipe->bru
+					: &input->entity;
+		}
+
 		/* Follow the source link. The link setup operations ensure
 		 * that the output fan-out can't be more than one, there is thus
 		 * no need to verify here that only a single source link is
 		 * activated.
 		 */
 		pad = &entity->pads[entity->source_pad];
-		pad = media_entity_remote_pad(pad);
+		pad = vsp2_entity_remote_pad(pad);
 	}
 
 	/* The last entity must be the output WPF. */
@@ -432,9 +1533,13 @@ static int vsp2_pipeline_validate_branch(struct vsp2_pipeline *pipe,
 
 static void __vsp2_pipeline_cleanup(struct vsp2_pipeline *pipe)
 {
+	unsigned int i;
+
+	for (i = 0; i < pipe->num_inputs; ++i)
+		v4l2_ctrl_grab(pipe->inputs[i]->virtual_ctrl, false);
+
 	if (pipe->bru) {
 		struct vsp2_bru *bru = to_bru(&pipe->bru->subdev);
-		unsigned int i;
 
 		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i)
 			bru->inputs[i].rpf = NULL;
@@ -447,6 +1552,14 @@ static void __vsp2_pipeline_cleanup(struct vsp2_pipeline *pipe)
 	pipe->num_inputs = 0;
 	pipe->output = NULL;
 	pipe->bru = NULL;
+	pipe->clu = NULL;
+	pipe->hgo = NULL;
+	pipe->hgt = NULL;
+	pipe->hst = NULL;
+	pipe->lif = NULL;
+	pipe->lut = NULL;
+	pipe->lut_hsv = false;
+	pipe->sru = NULL;
 	pipe->uds = NULL;
 }
 
@@ -456,6 +1569,7 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 	struct media_entity_graph graph;
 	struct media_entity *entity = &video->video.entity;
 	struct media_device *mdev = entity->parent;
+	struct vsp2_device *vsp2 = video->vsp2;
 	unsigned int i;
 	int ret;
 
@@ -470,6 +1584,13 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 		struct vsp2_entity *e;
 
 		if (media_entity_type(entity) != MEDIA_ENT_T_V4L2_SUBDEV) {
+			/* The histogram video nodes don't take part in the
+			 * pipeline start and stop.
+			 */
+			if (entity == &vsp2->hgo->histo.video.entity ||
+			    entity == &vsp2->hgt->histo.video.entity)
+				continue;
+
 			pipe->num_video++;
 			continue;
 		}
@@ -479,7 +1600,12 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 		list_add_tail(&e->list_pipe, &pipe->entities);
 
 		if (e->type == VSP2_ENTITY_RPF) {
+			/* The virtual mode decides which video nodes take part
+			 * in the pipeline, it can't change until the pipeline
+			 * is cleaned up.
+			 */
 			rwpf = to_rwpf(subdev);
+			v4l2_ctrl_grab(rwpf->virtual_ctrl, true);
 			pipe->inputs[pipe->num_inputs++] = rwpf;
 			rwpf->video.pipe_index = pipe->num_inputs;
 		} else if (e->type == VSP2_ENTITY_WPF) {
@@ -488,6 +1614,18 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 			rwpf->video.pipe_index = 0;
 		} else if (e->type == VSP2_ENTITY_BRU) {
 			pipe->bru = e;
+		} else if (e->type == VSP2_ENTITY_CLU) {
+			pipe->clu = e;
+		} else if (e->type == VSP2_ENTITY_HGO) {
+			pipe->hgo = e;
+		} else if (e->type == VSP2_ENTITY_HGT) {
+			pipe->hgt = e;
+		} else if (e->type == VSP2_ENTITY_HST) {
+			pipe->hst = e;
+		} else if (e->type == VSP2_ENTITY_LIF) {
+			pipe->lif = e;
+		} else if (e->type == VSP2_ENTITY_LUT) {
+			pipe->lut = e;
 		}
 	}
 
@@ -497,7 +1635,38 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 	if (pipe->num_inputs == 0 || !pipe->output) {
 		ret = -EPIPE;
 		goto error;
-	}
+	}
+
+	/* When the WPF feeds the display through the LIF the output video node
+	 * isn't used, the pipeline is started by the input video nodes only.
+	 */
+	if (pipe->lif) {
+		if (video == &pipe->output->video) {
+			ret = -EPIPE;
+			goto error;
+		}
+
+		pipe->num_video--;
+	}
+
+	/* Virtual RPFs generate solid color layers without reading memory,
+	 * their video nodes aren't used either.
+	 */
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		if (!pipe->inputs[i]->virtual)
+			continue;
+
+		if (video == &pipe->inputs[i]->video) {
+			ret = -EPIPE;
+			goto error;
+		}
+
+		pipe->num_video--;
+	}
+
+	ret = vsp2_rwpf_check_encodings(pipe);
+	if (ret < 0)
+		goto error;
 
 	/* Follow links downstream for each input and make sure the graph
 	 * contains no loop and that all branches end at the output WPF.
@@ -509,6 +1678,26 @@ static int vsp2_pipeline_validate(struct vsp2_pipeline *pipe,
 			goto error;
 	}
 
+	/* The jobs need at least one enabled input and a video node to pace
+	 * them, and the UDS must be fed by an enabled input.
+	 */
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		if (vsp2_pipeline_input_enabled(pipe, pipe->inputs[i]))
+			break;
+	}
+
+	if (i == pipe->num_inputs || !vsp2_pipeline_buffers_mask(pipe)) {
+		ret = -EPIPE;
+		goto error;
+	}
+
+	if (pipe->uds && pipe->uds_input->type == VSP2_ENTITY_RPF &&
+	    !vsp2_pipeline_input_enabled(pipe,
+					 to_rwpf(&pipe->uds_input->subdev))) {
+		ret = -EPIPE;
+		goto error;
+	}
+
 	return 0;
 
 error:
@@ -528,6 +1717,12 @@ static int vsp2_pipeline_init(struct vsp2_pipeline *pipe,
 		ret = vsp2_pipeline_validate(pipe, video);
 		if (ret < 0)
 			goto done;
+	} else if ((pipe->lif && video == &pipe->output->video) ||
+		   (video->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE &&
+		    to_rwpf(&video->rwpf->subdev)->virtual)) {
+		/* Video nodes left out of the pipeline can't join it. */
+		ret = -EPIPE;
+		goto done;
 	}
 
 	pipe->use_count++;
@@ -552,11 +1747,66 @@ static void vsp2_pipeline_cleanup(struct vsp2_pipeline *pipe)
 static void vsp2_pipeline_run(struct vsp2_pipeline *pipe)
 {
 	struct vsp2_device *vsp2 = pipe->output->entity.vsp2;
+	struct vsp2_pipeline_job job;
+	bool skip;
+
+	/* Apply the parameters bound to the output buffer and switch to the
+	 * preset selected since the last job. An input format can have been
+	 * switched since the parameters were set, drop them if they don't
+	 * match the pipeline formats anymore.
+	 */
+	if (pipe->output->params) {
+		if (vsp2_pipeline_check_params(pipe, pipe->output->params) < 0)
+			dev_dbg(vsp2->dev, "dropping stale buffer parameters\n");
+		else
+			vsp2_pipeline_apply_params(pipe, pipe->output->params);
+		pipe->output->params = NULL;
+	}
+
+	if (pipe->preset) {
+		if (vsp2_pipeline_check_params(pipe, pipe->preset) < 0)
+			dev_dbg(vsp2->dev, "dropping stale preset\n");
+		else
+			vsp2_pipeline_apply_params(pipe, pipe->preset);
+		pipe->preset = NULL;
+	}
+
+	/* The new parameters can enable inputs that have no buffer yet, wait
+	 * for them.
+	 */
+	if (!vsp2_pipeline_ready(pipe))
+		return;
+
+	if (vsp2_pipeline_setup_job(pipe, &job) < 0) {
+		dev_err(vsp2->dev, "failed to setup the pipeline job\n");
+		return;
+	}
+
+	/* When enabled, skip jobs identical to the previous one. The output
+	 * buffer already contains the result, the frame is completed without
+	 * involving the hardware. The display needs every frame when fed
+	 * through the LIF.
+	 */
+	skip = pipe->output->skip_redundant && !pipe->lif && pipe->job.valid &&
+	       vsp2_pipeline_job_equal(&pipe->job, &job);
+
+	pipe->job = job;
+	pipe->job.valid = true;
+	pipe->job.skipped = skip;
+
+	if (!skip)
+		vsp2_pipeline_configure(pipe, &job);
 
-	vsp2_vspm_drv_entry(vsp2);
+	pipe->frame_start = ktime_get();
 
+	if (skip)
+		vsp2_vspm_drv_skip(vsp2);
+	else
+		vsp2_vspm_drv_entry(vsp2);
+
+	/* Disabled inputs keep their buffer ready for when they get enabled. */
 	pipe->state = VSP2_PIPELINE_RUNNING;
-	pipe->buffers_ready = 0;
+	pipe->buffers_ready &= ~job.buffers;
 }
 
 static bool vsp2_pipeline_stopped(struct vsp2_pipeline *pipe)
@@ -595,33 +1845,251 @@ static int vsp2_pipeline_stop(struct vsp2_pipeline *pipe)
 
 static bool vsp2_pipeline_ready(struct vsp2_pipeline *pipe)
 {
-	unsigned int mask;
+	unsigned int mask = vsp2_pipeline_buffers_mask(pipe);
+
+	return (pipe->buffers_ready & mask) == mask;
+}
+
+/*
+ * vsp2_pipeline_enable_input - Enable or disable a BRU input while streaming
+ * @pipe: the pipeline
+ * @bru: the BRU
+ * @input: the BRU input index
+ * @enable: whether to enable or disable the input
+ *
+ * The change takes effect at the next job. The RPF count, the VSPM source
+ * slots and the Blend/ROP units routing are computed for each job from the
+ * enabled inputs. At least one input must stay enabled, and inputs scaled by
+ * a UDS can't be disabled as the UDS would be left without a source.
+ *
+ * Return 0 on success or a negative error code otherwise.
+ */
+int vsp2_pipeline_enable_input(struct vsp2_pipeline *pipe,
+			       struct vsp2_bru *bru, unsigned int input,
+			       bool enable)
+{
+	struct vsp2_rwpf *rpf = bru->inputs[input].rpf;
+	unsigned long flags;
+	unsigned int i;
+	bool staging;
+	int ret = 0;
+
+	if (pipe == NULL) {
+		bru->inputs[input].enabled = enable;
+		return 0;
+	}
+
+	spin_lock_irqsave(&pipe->irqlock, flags);
+
+	staging = vsp2_pipeline_staging(pipe);
+
+	if (!enable && rpf) {
+		if (vsp2_pipeline_input_uds(pipe, &rpf->entity)) {
+			ret = -EBUSY;
+			goto done;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(bru->inputs); ++i) {
+			if (i == input || !bru->inputs[i].rpf)
+				continue;
+
+			if (staging ? pipe->pending.enabled[i]
+				    : bru->inputs[i].enabled)
+				break;
+		}
+
+		if (i == ARRAY_SIZE(bru->inputs)) {
+			ret = -EBUSY;
+			goto done;
+		}
+	}
+
+	if (staging) {
+		pipe->pending.enabled[input] = enable;
+		pipe->pending_dirty = true;
+		goto done;
+	}
+
+	bru->inputs[input].enabled = enable;
+
+	/* Disabling an input the pipeline was waiting for can make it ready,
+	 * restart it in that case. The per-frame parameters are initialized
+	 * when the pipeline starts, don't run it before.
+	 */
+	if (pipe->params_ready && pipe->state == VSP2_PIPELINE_STOPPED &&
+	    vsp2_pipeline_ready(pipe))
+		vsp2_pipeline_run(pipe);
+
+done:
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+	return ret;
+}
+
+/*
+ * vsp2_pipeline_resize_input - Propagate an input size change
+ * @pipe: the pipeline
+ * @rpf: the RPF whose image size changes
+ * @width: the new image width
+ * @height: the new image height
+ * @apply: update the active formats, or only locate the entity absorbing the
+ *	size change
+ *
+ * The size is propagated downstream from the RPF through the entities that
+ * don't modify the image size, the LUT, CLU, HST and HSI, up to the UDS or
+ * BRU that absorbs it. The UDS sink pad format, or the BRU sink pad format
+ * and compose rectangle size, are updated. The UDS output size and the BRU
+ * composed image size don't change.
+ *
+ * Must be called with the pipeline irqlock held.
+ *
+ * Return the UDS or BRU sink pad the RPF image reaches, or NULL if the size
+ * change can't be absorbed by the pipeline.
+ */
+static struct media_pad *
+vsp2_pipeline_resize_input(struct vsp2_pipeline *pipe, struct vsp2_rwpf *rpf,
+			   unsigned int width, unsigned int height, bool apply)
+{
+	struct vsp2_entity *entity;
+	struct media_pad *pad;
+
+	pad = &rpf->entity.pads[RWPF_PAD_SOURCE];
+
+	while (1) {
+		pad = vsp2_entity_remote_pad(pad);
+		if (pad == NULL ||
+		    media_entity_type(pad->entity) != MEDIA_ENT_T_V4L2_SUBDEV)
+			return NULL;
+
+		entity =
+		    to_vsp2_entity(media_entity_to_v4l2_subdev(pad->entity));
+
+		switch (entity->type) {
+		case VSP2_ENTITY_UDS:
+			if (apply) {
+				entity->formats[UDS_PAD_SINK].width = width;
+				entity->formats[UDS_PAD_SINK].height = height;
+			}
+			return pad;
+
+		case VSP2_ENTITY_BRU:
+			if (apply) {
+				struct vsp2_bru *bru = to_bru(&entity->subdev);
+				unsigned int input = pad->index;
+
+				entity->formats[input].width = width;
+				entity->formats[input].height = height;
+				bru->inputs[input].compose.width = width;
+				bru->inputs[input].compose.height = height;
+
+				if (pipe->params_ready) {
+					pipe->pending.compose[input].width =
+						width;
+					pipe->pending.compose[input].height =
+						height;
+				}
+			}
+			return pad;
+
+		case VSP2_ENTITY_LUT:
+		case VSP2_ENTITY_CLU:
+		case VSP2_ENTITY_HST:
+		case VSP2_ENTITY_HSI:
+			if (apply) {
+				entity->formats[0].width = width;
+				entity->formats[0].height = height;
+				entity->formats[entity->source_pad].width =
+					width;
+				entity->formats[entity->source_pad].height =
+					height;
+			}
+			break;
+
+		default:
+			return NULL;
+		}
+
+		pad = &entity->pads[entity->source_pad];
+	}
+}
+
+/*
+ * vsp2_video_switch_format - Switch to the format set while streaming
+ * @pipe: the pipeline the video node belongs to
+ * @video: the video node
+ *
+ * Called with the pipeline irqlock held when the first buffer queued after a
+ * format change becomes the current buffer. The RPF is reconfigured for the
+ * next job, the new size is propagated to the entity absorbing it, and a
+ * source change event is sent to the video node listeners.
+ *
+ * The format state of a streaming video node is modified with both the
+ * pipeline and video irqlocks held, and can be read with either of them held.
+ */
+static void vsp2_video_switch_format(struct vsp2_pipeline *pipe,
+				     struct vsp2_video *video)
+{
+	struct vsp2_rwpf *rpf = to_rwpf(&video->rwpf->subdev);
+	struct v4l2_rect crop = rpf->crop;
+	struct v4l2_event event;
+	unsigned long flags;
+
+	spin_lock_irqsave(&video->irqlock, flags);
+	video->format = video->next_format;
+	video->fmtinfo = video->next_fmtinfo;
+	video->format_pending = false;
+	video->format_queued = false;
+	spin_unlock_irqrestore(&video->irqlock, flags);
 
-	mask = ((1 << pipe->num_inputs) - 1) << 1;
-	mask |= 1 << 0;
+	vsp2_rpf_set_format(rpf);
 
-	return pipe->buffers_ready == mask;
+	if (rpf->crop.width != crop.width || rpf->crop.height != crop.height)
+		vsp2_pipeline_resize_input(pipe, rpf, rpf->crop.width,
+					   rpf->crop.height, true);
+
+	if (pipe->params_ready)
+		pipe->pending.crop[rpf->entity.index] = rpf->crop;
+
+	/* The presets have been stored for the previous format. */
+	pipe->output->presets_valid = 0;
+	pipe->preset = NULL;
+
+	pipe->job.valid = false;
+
+	memset(&event, 0, sizeof(event));
+	event.type = V4L2_EVENT_SOURCE_CHANGE;
+	event.u.src_change.changes = V4L2_EVENT_SRC_CH_RESOLUTION;
+	v4l2_event_queue(&video->video, &event);
 }
 
 /*
  * vsp2_video_complete_buffer - Complete the current buffer
+ * @pipe: the pipeline the video node belongs to
  * @video: the video node
  *
  * This function completes the current buffer by filling its sequence number,
  * time stamp and payload size, and hands it back to the videobuf core.
  *
+ * Input buffers keep the time stamp supplied by userspace. The time stamp,
+ * time code and frame type flags of the master input buffer, read by the
+ * bottom-most composed layer of the job, are copied to the output buffer. The
+ * metadata of the previous master buffer is reused when the job reads no layer
+ * from memory. The processing start and end times of the frame are recorded in
+ * the output WPF.
+ *
  * When operating in DU output mode (deep pipeline to the DU through the LIF),
  * the VSP2 needs to constantly supply frames to the display. In that case, if
- * no other buffer is queued, reuse the one that has just been processed instead
- * of handing it back to the videobuf core.
+ * no other input buffer is queued, reuse the one that has just been processed
+ * instead of handing it back to the videobuf core.
  *
  * Return the next queued buffer or NULL if the queue is empty.
  */
 static struct vsp2_video_buffer *
-vsp2_video_complete_buffer(struct vsp2_video *video)
+vsp2_video_complete_buffer(struct vsp2_pipeline *pipe,
+			   struct vsp2_video *video)
 {
 	struct vsp2_video_buffer *next = NULL;
 	struct vsp2_video_buffer *done;
+	struct v4l2_buffer *v4l2_buf;
 	unsigned long flags;
 	unsigned int i;
 
@@ -635,6 +2103,15 @@ vsp2_video_complete_buffer(struct vsp2_video *video)
 	done = list_first_entry(&video->irqqueue,
 				struct vsp2_video_buffer, queue);
 
+	if (pipe->lif && video->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE &&
+	    list_is_singular(&video->irqqueue)) {
+		spin_unlock_irqrestore(&video->irqlock, flags);
+
+		/* The format change has already been applied. */
+		done->format_change = false;
+		return done;
+	}
+
 	if (!list_is_singular(&video->irqqueue))
 		next = list_entry(done->queue.next,
 					struct vsp2_video_buffer, queue);
@@ -643,8 +2120,34 @@ vsp2_video_complete_buffer(struct vsp2_video *video)
 
 	spin_unlock_irqrestore(&video->irqlock, flags);
 
-	done->buf.v4l2_buf.sequence = video->sequence++;
-	v4l2_get_timestamp(&done->buf.v4l2_buf.timestamp);
+	v4l2_buf = &done->buf.v4l2_buf;
+	v4l2_buf->sequence = video->sequence++;
+
+	if (video->type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
+		if (video->pipe_index == pipe->job.master) {
+			pipe->master.timestamp = v4l2_buf->timestamp;
+			pipe->master.timecode = v4l2_buf->timecode;
+			pipe->master.flags = v4l2_buf->flags
+					   & VSP2_VIDEO_BUF_COPY_FLAGS;
+		}
+	} else {
+		struct vsp2_rwpf *wpf =
+			container_of(video, struct vsp2_rwpf, video);
+
+		v4l2_buf->timestamp = pipe->master.timestamp;
+		v4l2_buf->timecode = pipe->master.timecode;
+		v4l2_buf->flags &= ~VSP2_VIDEO_BUF_COPY_FLAGS;
+		v4l2_buf->flags |= pipe->master.flags;
+
+		spin_lock_irqsave(&video->irqlock, flags);
+		wpf->timing.sequence = v4l2_buf->sequence;
+		wpf->timing.start = ktime_to_ns(pipe->frame_start);
+		wpf->timing.end = ktime_to_ns(pipe->frame_end);
+		if (pipe->job.skipped)
+			wpf->timing.skipped++;
+		spin_unlock_irqrestore(&video->irqlock, flags);
+	}
+
 	for (i = 0; i < done->buf.num_planes; ++i)
 		vb2_set_plane_payload(&done->buf, i, done->length[i]);
 	vb2_buffer_done(&done->buf, VB2_BUF_STATE_DONE);
@@ -657,12 +2160,15 @@ static void vsp2_video_frame_end(struct vsp2_pipeline *pipe,
 	struct vsp2_video_buffer *buf;
 	unsigned long flags;
 
-	buf = vsp2_video_complete_buffer(video);
+	buf = vsp2_video_complete_buffer(pipe, video);
 	if (buf == NULL)
 		return;
 
 	spin_lock_irqsave(&pipe->irqlock, flags);
 
+	if (buf->format_change)
+		vsp2_video_switch_format(pipe, video);
+
 	video->ops->queue(video, buf);
 	pipe->buffers_ready |= 1 << video->pipe_index;
 
@@ -678,11 +2184,37 @@ void vsp2_pipeline_frame_end(struct vsp2_pipeline *pipe)
 	if (pipe == NULL)
 		return;
 
-	/* Complete buffers on all video nodes. */
-	for (i = 0; i < pipe->num_inputs; ++i)
-		vsp2_video_frame_end(pipe, &pipe->inputs[i]->video);
+	pipe->frame_end = ktime_get();
+
+	/* Complete buffers on all video nodes. The inputs must be completed
+	 * first to record the master input buffer metadata.
+	 */
+	for (i = 0; i < pipe->num_inputs; ++i) {
+		struct vsp2_video *video = &pipe->inputs[i]->video;
+
+		if (pipe->job.buffers & (1 << video->pipe_index))
+			vsp2_video_frame_end(pipe, video);
+	}
+
+	/* There's no output buffer when feeding the display through the LIF,
+	 * count the frames for the histograms sequence numbers.
+	 */
+	if (pipe->lif)
+		pipe->output->video.sequence++;
+	else
+		vsp2_video_frame_end(pipe, &pipe->output->video);
 
-	vsp2_video_frame_end(pipe, &pipe->output->video);
+	/* Deliver the histograms with the sequence number of the output
+	 * buffer they have been computed from.
+	 */
+	if (pipe->hgo)
+		vsp2_histogram_frame_end(to_histogram(&pipe->hgo->subdev),
+					 pipe->output->video.sequence - 1,
+					 &pipe->master.timestamp);
+	if (pipe->hgt)
+		vsp2_histogram_frame_end(to_histogram(&pipe->hgt->subdev),
+					 pipe->output->video.sequence - 1,
+					 &pipe->master.timestamp);
 
 	spin_lock_irqsave(&pipe->irqlock, flags);
 
@@ -720,7 +2252,7 @@ void vsp2_pipeline_propagate_alpha(struct vsp2_pipeline *pipe,
 	struct vsp2_entity *entity;
 	struct media_pad *pad;
 
-	pad = media_entity_remote_pad(&input->pads[RWPF_PAD_SOURCE]);
+	pad = vsp2_entity_remote_pad(&input->pads[RWPF_PAD_SOURCE]);
 
 	while (pad) {
 		if (media_entity_type(pad->entity) != MEDIA_ENT_T_V4L2_SUBDEV)
@@ -743,7 +2275,7 @@ void vsp2_pipeline_propagate_alpha(struct vsp2_pipeline *pipe,
 		}
 
 		pad = &entity->pads[entity->source_pad];
-		pad = media_entity_remote_pad(pad);
+		pad = vsp2_entity_remote_pad(pad);
 	}
 }
 
@@ -854,20 +2386,16 @@ static int vsp2_video_buffer_prepare(struct vb2_buffer *vb)
 {
 	struct vsp2_video *video = vb2_get_drv_priv(vb->vb2_queue);
 	struct vsp2_video_buffer *buf = to_vsp2_video_buffer(vb);
-	const struct v4l2_pix_format_mplane *format = &video->format;
+	const struct v4l2_pix_format_mplane *format;
+	unsigned long flags;
 	unsigned int i;
-
-	if (vb->num_planes < format->num_planes)
-		return -EINVAL;
+	int ret = 0;
 
 	buf->video = video;
 
 	for (i = 0; i < vb->num_planes; ++i) {
 		buf->addr[i] = vb2_dma_contig_plane_dma_addr(vb, i);
 		buf->length[i] = vb2_plane_size(vb, i);
-
-		if (buf->length[i] < format->plane_fmt[i].sizeimage)
-			return -EINVAL;
 	}
 
 	for ( ; i < 3; ++i) {
@@ -875,7 +2403,22 @@ static int vsp2_video_buffer_prepare(struct vb2_buffer *vb)
 		buf->length[i] = 0;
 	}
 
-	return 0;
+	/* The format can be switched by the pipeline while streaming. */
+	spin_lock_irqsave(&video->irqlock, flags);
+
+	format = video->format_pending ? &video->next_format : &video->format;
+
+	if (vb->num_planes < format->num_planes)
+		ret = -EINVAL;
+
+	for (i = 0; i < format->num_planes && !ret; ++i) {
+		if (buf->length[i] < format->plane_fmt[i].sizeimage)
+			ret = -EINVAL;
+	}
+
+	spin_unlock_irqrestore(&video->irqlock, flags);
+
+	return ret;
 }
 
 static void vsp2_video_buffer_queue(struct vb2_buffer *vb)
@@ -886,7 +2429,16 @@ static void vsp2_video_buffer_queue(struct vb2_buffer *vb)
 	unsigned long flags;
 	bool empty;
 
+	if (video->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		vsp2_pipeline_bind_params(pipe, buf);
+
 	spin_lock_irqsave(&video->irqlock, flags);
+
+	/* The first buffer queued after a format change carries the change. */
+	buf->format_change = video->format_pending && !video->format_queued;
+	if (buf->format_change)
+		video->format_queued = true;
+
 	empty = list_empty(&video->irqqueue);
 	list_add_tail(&buf->queue, &video->irqqueue);
 	spin_unlock_irqrestore(&video->irqlock, flags);
@@ -896,6 +2448,9 @@ static void vsp2_video_buffer_queue(struct vb2_buffer *vb)
 
 	spin_lock_irqsave(&pipe->irqlock, flags);
 
+	if (buf->format_change)
+		vsp2_video_switch_format(pipe, video);
+
 	video->ops->queue(video, buf);
 	pipe->buffers_ready |= 1 << video->pipe_index;
 
@@ -921,6 +2476,26 @@ static void vsp2_entity_route_setup(struct vsp2_entity *source)
 	case VSP2_ENTITY_WPF:
 		connect = 0;
 		break;
+	case VSP2_ENTITY_CLU:
+		vsp_start->use_module |= VSP_CLU_USE;
+		connect = VSP_CLU_USE;
+		break;
+	case VSP2_ENTITY_HSI:
+		vsp_start->use_module |= VSP_HSI_USE;
+		connect = VSP_HSI_USE;
+		break;
+	case VSP2_ENTITY_HST:
+		vsp_start->use_module |= VSP_HST_USE;
+		connect = VSP_HST_USE;
+		break;
+	case VSP2_ENTITY_LUT:
+		vsp_start->use_module |= VSP_LUT_USE;
+		connect = VSP_LUT_USE;
+		break;
+	case VSP2_ENTITY_SRU:
+		vsp_start->use_module |= VSP_SRU_USE;
+		connect = VSP_SRU_USE;
+		break;
 	case VSP2_ENTITY_UDS:
 		vsp_start->use_module |= VSP_UDS_USE;
 		connect = VSP_UDS_USE;
@@ -939,26 +2514,29 @@ static void vsp2_entity_route_setup(struct vsp2_entity *source)
 
 	switch (source->type) {
 	case VSP2_ENTITY_RPF:
-		switch (source->index) {
-		case 0:
-			vsp_start->src1_par->connect = connect;
-			break;
-		case 1:
-			vsp_start->src2_par->connect = connect;
-			break;
-		case 2:
-			vsp_start->src3_par->connect = connect;
-			break;
-		case 3:
-			vsp_start->src4_par->connect = connect;
-			break;
-		default:
+		if (source->index >= VSP2_COUNT_RPF) {
 			dev_err(source->vsp2->dev,
 				"Invalid PRF index.(%d)\n",
 				source->index);
 			/* Invalid index. */
 			break;
 		}
+		source->vsp2->vspm->in[source->index]->connect = connect;
+		break;
+	case VSP2_ENTITY_CLU:
+		vsp_start->ctrl_par->clu->connect = connect;
+		break;
+	case VSP2_ENTITY_HSI:
+		vsp_start->ctrl_par->hsi->connect = connect;
+		break;
+	case VSP2_ENTITY_HST:
+		vsp_start->ctrl_par->hst->connect = connect;
+		break;
+	case VSP2_ENTITY_LUT:
+		vsp_start->ctrl_par->lut->connect = connect;
+		break;
+	case VSP2_ENTITY_SRU:
+		vsp_start->ctrl_par->sru->connect = connect;
 		break;
 	case VSP2_ENTITY_UDS:
 		vsp_start->ctrl_par->uds->connect = connect;
@@ -1004,6 +2582,11 @@ static int vsp2_video_start_streaming(struct vb2_queue *vq, unsigned int count)
 			}
 		}
 
+		/* The VSPM parameters are reprogrammed from scratch, the first
+		 * job can't be redundant.
+		 */
+		pipe->job.valid = false;
+
 		list_for_each_entry(entity, &pipe->entities, list_pipe) {
 			vsp2_entity_route_setup(entity);
 
@@ -1014,6 +2597,10 @@ static int vsp2_video_start_streaming(struct vb2_queue *vq, unsigned int count)
 				return ret;
 			}
 		}
+
+		spin_lock_irqsave(&pipe->irqlock, flags);
+		vsp2_pipeline_init_params(pipe);
+		spin_unlock_irqrestore(&pipe->irqlock, flags);
 	}
 
 	pipe->stream_count++;
@@ -1042,11 +2629,31 @@ static int vsp2_video_stop_streaming(struct vb2_queue *vq)
 		if (ret == -ETIMEDOUT)
 			dev_err(video->vsp2->dev, "pipeline stop timeout\n");
 
+		/* Drop the per-frame parameters that haven't been applied. */
+		spin_lock_irqsave(&pipe->irqlock, flags);
+		pipe->params_ready = false;
+		pipe->pending_dirty = false;
+		pipe->output->params = NULL;
+		pipe->preset = NULL;
+		spin_unlock_irqrestore(&pipe->irqlock, flags);
+
 		/* Initialize the VSPM parameters. */
 		vsp2_vspm_param_init(&video->vsp2->vspm->ip_par);
 	}
 	mutex_unlock(&pipe->lock);
 
+	/* A format change that hasn't reached the hardware becomes the format
+	 * for the next stream.
+	 */
+	spin_lock_irqsave(&video->irqlock, flags);
+	if (video->format_pending) {
+		video->format = video->next_format;
+		video->fmtinfo = video->next_fmtinfo;
+		video->format_pending = false;
+		video->format_queued = false;
+	}
+	spin_unlock_irqrestore(&video->irqlock, flags);
+
 	vsp2_pipeline_cleanup(pipe);
 	media_entity_pipeline_stop(&video->video.entity);
 
@@ -1074,6 +2681,122 @@ static struct vb2_ops vsp2_video_queue_qops = {
  * V4L2 ioctls
  */
 
+/*
+ * vsp2_video_change_format - Change the input format while streaming
+ * @video: the RPF video node, with its lock held
+ * @format: the new format
+ * @info: the new format information
+ *
+ * The new resolution is applied to the first buffer queued after the change,
+ * without stopping the stream. The already allocated buffers are reused, all
+ * of them must be large enough for the new format. The media bus code can't
+ * change, and the new size must be absorbed by the pipeline unless the size
+ * doesn't change: the RPF must feed, possibly through entities that don't
+ * modify the image size, a UDS able to scale the new size to its output size,
+ * or a BRU with the new image fitting in the composed image. The composed
+ * image size is only known when the BRU output isn't scaled. The UDS or BRU
+ * sink format and the BRU compose rectangle follow the new size when the
+ * format is switched.
+ *
+ * Size changes are rejected when the pipeline contains an HGO or HGT, as the
+ * histogram window is programmed when the stream starts.
+ */
+static int vsp2_video_change_format(struct vsp2_video *video,
+				    const struct v4l2_pix_format_mplane *format,
+				    const struct vsp2_format_info *info)
+{
+	struct vsp2_pipeline *pipe = to_vsp2_pipeline(&video->video.entity);
+	struct vsp2_entity *entity;
+	struct vsp2_rwpf *rpf;
+	struct media_pad *pad;
+	unsigned long flags;
+	unsigned int i;
+	unsigned int j;
+	int ret = 0;
+
+	if (video->type != V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE || pipe == NULL)
+		return -EBUSY;
+
+	for (i = 0; i < video->queue.num_buffers; ++i) {
+		struct vb2_buffer *vb = video->queue.bufs[i];
+
+		for (j = 0; j < format->num_planes; ++j) {
+			if (vb2_plane_size(vb, j) <
+			    format->plane_fmt[j].sizeimage)
+				return -EBUSY;
+		}
+	}
+
+	rpf = to_rwpf(&video->rwpf->subdev);
+
+	/* The current format, the crop rectangle and the pipeline formats are
+	 * modified by the pipeline when it switches to a new format.
+	 */
+	spin_lock_irqsave(&pipe->irqlock, flags);
+	spin_lock(&video->irqlock);
+
+	/* Only one change can be pending at a time. */
+	if (video->format_pending) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* The encoding is shared by the pipeline inputs and output, and
+	 * checked when the pipeline starts.
+	 */
+	if (info->mbus != video->fmtinfo->mbus ||
+	    format->num_planes != video->format.num_planes ||
+	    format->colorspace != video->format.colorspace ||
+	    format->ycbcr_enc != video->format.ycbcr_enc ||
+	    format->quantization != video->format.quantization) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	if (format->width != rpf->crop.width ||
+	    format->height != rpf->crop.height) {
+		pad = vsp2_pipeline_resize_input(pipe, rpf, format->width,
+						 format->height, false);
+		if (pad == NULL || pipe->hgo || pipe->hgt) {
+			ret = -EBUSY;
+			goto done;
+		}
+
+		entity =
+		    to_vsp2_entity(media_entity_to_v4l2_subdev(pad->entity));
+
+		if (entity->type == VSP2_ENTITY_UDS) {
+			if (!vsp2_uds_input_supported(to_uds(&entity->subdev),
+						      format->width,
+						      format->height))
+				ret = -ERANGE;
+		} else if (!pipe->sru &&
+			   !vsp2_pipeline_input_uds(pipe, pipe->bru)) {
+			const struct v4l2_mbus_framefmt *output =
+				&entity->formats[BRU_PAD_SOURCE];
+
+			if (rpf->location.left + format->width > output->width ||
+			    rpf->location.top + format->height > output->height)
+				ret = -ERANGE;
+		} else {
+			ret = -EBUSY;
+		}
+
+		if (ret < 0)
+			goto done;
+	}
+
+	video->next_format = *format;
+	video->next_fmtinfo = info;
+	video->format_queued = false;
+	video->format_pending = true;
+
+done:
+	spin_unlock(&video->irqlock);
+	spin_unlock_irqrestore(&pipe->irqlock, flags);
+	return ret;
+}
+
 static int
 vsp2_video_querycap(struct file *file, void *fh, struct v4l2_capability *cap)
 {
@@ -1104,12 +2827,18 @@ vsp2_video_get_format(struct file *file, void *fh, struct v4l2_format *format)
 {
 	struct v4l2_fh *vfh = file->private_data;
 	struct vsp2_video *video = to_vsp2_video(vfh->vdev);
+	unsigned long flags;
 
 	if (format->type != video->queue.type)
 		return -EINVAL;
 
 	mutex_lock(&video->lock);
-	format->fmt.pix_mp = video->format;
+	spin_lock_irqsave(&video->irqlock, flags);
+	if (video->format_pending)
+		format->fmt.pix_mp = video->next_format;
+	else
+		format->fmt.pix_mp = video->format;
+	spin_unlock_irqrestore(&video->irqlock, flags);
 	mutex_unlock(&video->lock);
 
 	return 0;
@@ -1144,6 +2873,11 @@ vsp2_video_set_format(struct file *file, void *fh, struct v4l2_format *format)
 
 	mutex_lock(&video->lock);
 
+	if (vb2_is_streaming(&video->queue)) {
+		ret = vsp2_video_change_format(video, &format->fmt.pix_mp, info);
+		goto done;
+	}
+
 	if (vb2_is_busy(&video->queue)) {
 		ret = -EBUSY;
 		goto done;
@@ -1157,6 +2891,18 @@ done:
 	return ret;
 }
 
+static int
+vsp2_video_subscribe_event(struct v4l2_fh *fh,
+			   const struct v4l2_event_subscription *sub)
+{
+	switch (sub->type) {
+	case V4L2_EVENT_SOURCE_CHANGE:
+		return v4l2_src_change_event_subscribe(fh, sub);
+	default:
+		return -EINVAL;
+	}
+}
+
 static int
 vsp2_video_streamon(struct file *file, void *fh, enum v4l2_buf_type type)
 {
@@ -1224,6 +2970,8 @@ static const struct v4l2_ioctl_ops vsp2_video_ioctl_ops = {
 	.vidioc_prepare_buf		= vb2_ioctl_prepare_buf,
 	.vidioc_streamon		= vsp2_video_streamon,
 	.vidioc_streamoff		= vb2_ioctl_streamoff,
+	.vidioc_subscribe_event		= vsp2_video_subscribe_event,
+	.vidioc_unsubscribe_event	= v4l2_event_unsubscribe,
 };
 
 /* -----------------------------------------------------------------------------
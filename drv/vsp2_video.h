@@ -62,6 +62,7 @@
 #ifndef __VSP2_VIDEO_H__
 #define __VSP2_VIDEO_H__
 
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/wait.h>
@@ -69,6 +70,9 @@
 #include <media/media-entity.h>
 #include <media/videobuf2-core.h>
 
+struct vsp2_bru;
+struct vsp2_rwpf;
+struct vsp2_uds;
 struct vsp2_video;
 
 /*
@@ -83,6 +87,8 @@ struct vsp2_video;
  * @hsub: horizontal subsampling factor
  * @vsub: vertical subsampling factor
  * @alpha: has an alpha channel
+ * @alpha_plane: the last plane holds an external 8-bit alpha component
+ * @clut: the pixels are 8-bit indices in the RPF palette
  */
 struct vsp2_format_info {
 	u32 fourcc;
@@ -96,6 +102,68 @@ struct vsp2_format_info {
 	unsigned int hsub;
 	unsigned int vsub;
 	bool alpha;
+	bool alpha_plane;
+	bool clut;
+};
+
+/*
+ * struct vsp2_pipeline_layer - An input composed by a pipeline job
+ * @rpf: the RPF reading the input
+ * @crop: the part of the input image read for the job
+ * @left: horizontal position of the input in the composed image
+ * @top: vertical position of the input in the composed image
+ */
+struct vsp2_pipeline_layer {
+	struct vsp2_rwpf *rpf;
+	struct v4l2_rect crop;
+	unsigned int left;
+	unsigned int top;
+};
+
+/*
+ * struct vsp2_pipeline_params - Per-frame parameters of a pipeline
+ * @crop: RPF crop rectangles, indexed by RPF index
+ * @alpha: RPF alpha values, indexed by RPF index
+ * @compose: BRU compose rectangles, indexed by BRU input
+ * @bgcolor: BRU background color
+ * @enabled: BRU inputs enable state, indexed by BRU input
+ * @damage: output WPF damage rectangle, used by a single job
+ */
+struct vsp2_pipeline_params {
+	struct v4l2_rect crop[VSP2_COUNT_RPF];
+	unsigned int alpha[VSP2_COUNT_RPF];
+	struct v4l2_rect compose[4];
+	u32 bgcolor;
+	bool enabled[4];
+	struct v4l2_rect damage;
+};
+
+/*
+ * struct vsp2_pipeline_job - Parameters of a job submitted to the VSPM
+ * @valid: the parameters describe the last submitted job
+ * @skipped: the job has been completed without being submitted
+ * @partial: only @window has been composed
+ * @window: the composed window, in output WPF sink pad coordinates
+ * @layers: the composed layers, from bottom to top
+ * @num_layers: the number of composed layers
+ * @addr: the layers buffer addresses
+ * @out_addr: the output buffer addresses
+ * @buffers: mask of the video nodes whose buffers are used by the job, indexed
+ *	by pipe_index
+ * @master: pipe_index of the master input video node, or 0 if no composed
+ *	layer is read from memory
+ */
+struct vsp2_pipeline_job {
+	bool valid;
+	bool skipped;
+	bool partial;
+	struct v4l2_rect window;
+	struct vsp2_pipeline_layer layers[VSP2_COUNT_RPF];
+	unsigned int num_layers;
+	dma_addr_t addr[VSP2_COUNT_RPF][3];
+	dma_addr_t out_addr[3];
+	unsigned int buffers;
+	unsigned int master;
 };
 
 enum vsp2_pipeline_state {
@@ -109,6 +177,16 @@ enum vsp2_pipeline_state {
  * @media: the media pipeline
  * @irqlock: protects the pipeline state
  * @lock: protects the pipeline use count and stream count
+ * @frame_start: time at which the current frame has been submitted
+ * @frame_end: time at which the last frame has completed
+ * @master: metadata of the last completed master input buffer, copied to the
+ *	output buffer
+ * @job: parameters of the last submitted job
+ * @params_ready: @pending has been initialized and changes can be staged
+ * @pending_dirty: @pending has been modified since the last output buffer
+ *	has been queued
+ * @pending: per-frame parameters staged for the next queued output buffer
+ * @preset: preset parameters to be applied to the next job
  */
 struct vsp2_pipeline {
 	struct media_pipeline pipe;
@@ -127,9 +205,34 @@ struct vsp2_pipeline {
 	struct vsp2_rwpf *inputs[VSP2_COUNT_RPF];
 	struct vsp2_rwpf *output;
 	struct vsp2_entity *bru;
+	struct vsp2_entity *clu;
+	struct vsp2_entity *hgo;
+	struct vsp2_entity *hgt;
+	struct vsp2_entity *hst;
+	struct vsp2_entity *lif;
+	struct vsp2_entity *lut;
+	bool lut_hsv;
+	struct vsp2_entity *sru;
+	struct vsp2_entity *sru_input;
 	struct vsp2_entity *uds;
 	struct vsp2_entity *uds_input;
 
+	ktime_t frame_start;
+	ktime_t frame_end;
+
+	struct {
+		struct timeval timestamp;
+		struct v4l2_timecode timecode;
+		u32 flags;
+	} master;
+
+	struct vsp2_pipeline_job job;
+
+	bool params_ready;
+	bool pending_dirty;
+	struct vsp2_pipeline_params pending;
+	const struct vsp2_pipeline_params *preset;
+
 	struct list_head entities;
 };
 
@@ -149,6 +252,10 @@ struct vsp2_video_buffer {
 	dma_addr_t addr[3];
 	unsigned int length[3];
 
+	bool format_change;
+
+	bool has_params;
+	struct vsp2_pipeline_params params;
 };
 
 static inline struct vsp2_video_buffer *
@@ -175,6 +282,16 @@ struct vsp2_video {
 	struct v4l2_pix_format_mplane format;
 	const struct vsp2_format_info *fmtinfo;
 
+	/*
+	 * Format set while streaming, applied with the first buffer queued
+	 * after the change. The format fields of a streaming video node are
+	 * switched with both the pipeline irqlock and the video irqlock held.
+	 */
+	bool format_pending;
+	bool format_queued;
+	struct v4l2_pix_format_mplane next_format;
+	const struct vsp2_format_info *next_fmtinfo;
+
 	struct vsp2_pipeline pipe;
 	unsigned int pipe_index;
 
@@ -194,6 +311,31 @@ int vsp2_video_init(struct vsp2_video *video, struct vsp2_entity *rwpf);
 void vsp2_video_cleanup(struct vsp2_video *video);
 
 void vsp2_pipeline_frame_end(struct vsp2_pipeline *pipe);
+void vsp2_pipeline_invalidate_job(struct vsp2_pipeline *pipe);
+
+struct vsp2_uds *vsp2_pipeline_input_uds(struct vsp2_pipeline *pipe,
+					 struct vsp2_entity *input);
+
+int vsp2_pipeline_set_crop(struct vsp2_pipeline *pipe, struct vsp2_rwpf *rwpf,
+			   const struct v4l2_rect *crop);
+void vsp2_pipeline_set_alpha(struct vsp2_pipeline *pipe, struct vsp2_rwpf *rpf,
+			     unsigned int alpha);
+void vsp2_pipeline_set_compose(struct vsp2_pipeline *pipe, struct vsp2_bru *bru,
+			       unsigned int input,
+			       const struct v4l2_rect *compose);
+void vsp2_pipeline_set_bgcolor(struct vsp2_pipeline *pipe, struct vsp2_bru *bru,
+			       u32 bgcolor);
+void vsp2_pipeline_set_damage(struct vsp2_pipeline *pipe,
+			      const struct v4l2_rect *damage);
+void vsp2_pipeline_set_request_mode(struct vsp2_pipeline *pipe,
+				    struct vsp2_rwpf *wpf, bool enable);
+void vsp2_pipeline_store_preset(struct vsp2_pipeline *pipe,
+				struct vsp2_pipeline_params *preset);
+int vsp2_pipeline_load_preset(struct vsp2_pipeline *pipe,
+			      const struct vsp2_pipeline_params *preset);
+int vsp2_pipeline_enable_input(struct vsp2_pipeline *pipe,
+			       struct vsp2_bru *bru, unsigned int input,
+			       bool enable);
 
 void vsp2_pipeline_propagate_alpha(struct vsp2_pipeline *pipe,
 				   struct vsp2_entity *input,
@@ -60,10 +60,12 @@
 */ /*************************************************************************/
 
 #include "vsp2.h"
+#include "vsp2_rwpf.h"
 #include "vsp2_vspm.h"
 
 void vsp2_vspm_param_init(VSPM_IP_PAR *par)
 {
+	struct vsp2_vspm *vspm = container_of(par, struct vsp2_vspm, ip_par);
 	VSPM_VSP_PAR *vsp_par = par->unionIpParam.ptVsp;
 	void *temp_vp;
 	int i;
@@ -76,26 +78,13 @@ void vsp2_vspm_param_init(VSPM_IP_PAR *par)
 	vsp_par->rpf_order	= 0;
 	vsp_par->use_module	= 0;
 
-	for (i = 0; i < 4; i++) {
-		T_VSP_IN *vsp_in;
+	vsp_par->src1_par	= vspm->in[0];
+	vsp_par->src2_par	= vspm->in[1];
+	vsp_par->src3_par	= vspm->in[2];
+	vsp_par->src4_par	= vspm->in[3];
 
-		switch (i) {
-		case 0:
-			vsp_in = vsp_par->src1_par;
-			break;
-		case 1:
-			vsp_in = vsp_par->src2_par;
-			break;
-		case 2:
-			vsp_in = vsp_par->src3_par;
-			break;
-		case 3:
-			vsp_in = vsp_par->src4_par;
-			break;
-		default:
-			/* Invalid index. */
-			break;
-		}
+	for (i = 0; i < VSP2_COUNT_RPF; i++) {
+		T_VSP_IN *vsp_in = vspm->in[i];
 
 		/* Initialize T_VSP_IN. */
 		temp_vp = vsp_in->alpha_blend;
@@ -109,6 +98,27 @@ void vsp2_vspm_param_init(VSPM_IP_PAR *par)
 	/* Initialize T_VSP_OUT. */
 	memset(vsp_par->dst_par, 0x00, sizeof(T_VSP_OUT));
 
+	/* Initialize T_VSP_CLU. */
+	memset(vsp_par->ctrl_par->clu, 0x00, sizeof(T_VSP_CLU));
+
+	/* Initialize T_VSP_HGO. */
+	memset(vsp_par->ctrl_par->hgo, 0x00, sizeof(T_VSP_HGO));
+
+	/* Initialize T_VSP_HGT. */
+	memset(vsp_par->ctrl_par->hgt, 0x00, sizeof(T_VSP_HGT));
+
+	/* Initialize T_VSP_HSI. */
+	memset(vsp_par->ctrl_par->hsi, 0x00, sizeof(T_VSP_HSI));
+
+	/* Initialize T_VSP_HST. */
+	memset(vsp_par->ctrl_par->hst, 0x00, sizeof(T_VSP_HST));
+
+	/* Initialize T_VSP_LUT. */
+	memset(vsp_par->ctrl_par->lut, 0x00, sizeof(T_VSP_LUT));
+
+	/* Initialize T_VSP_SRU. */
+	memset(vsp_par->ctrl_par->sru, 0x00, sizeof(T_VSP_SRU));
+
 	/* Initialize T_VSP_UDS. */
 	memset(vsp_par->ctrl_par->uds, 0x00, sizeof(T_VSP_OUT));
 
@@ -221,6 +231,7 @@ static int vsp2_vspm_alloc_vsp_bru(struct device *dev, T_VSP_BRU **bru)
 static int vsp2_vspm_alloc(struct vsp2_device *vsp2)
 {
 	VSPM_VSP_PAR *vsp_par = NULL;
+	unsigned int i;
 	int ret = 0;
 
 	vsp2->vspm = devm_kzalloc(vsp2->dev, sizeof(*vsp2->vspm), GFP_KERNEL);
@@ -236,18 +247,19 @@ static int vsp2_vspm_alloc(struct vsp2_device *vsp2)
 
 	vsp_par = vsp2->vspm->ip_par.unionIpParam.ptVsp;
 
-	ret = vsp2_vspm_alloc_vsp_in(vsp2->dev, &vsp_par->src1_par);
-	if (ret != 0)
-		return -ENOMEM;
-	ret = vsp2_vspm_alloc_vsp_in(vsp2->dev, &vsp_par->src2_par);
-	if (ret != 0)
-		return -ENOMEM;
-	ret = vsp2_vspm_alloc_vsp_in(vsp2->dev, &vsp_par->src3_par);
-	if (ret != 0)
-		return -ENOMEM;
-	ret = vsp2_vspm_alloc_vsp_in(vsp2->dev, &vsp_par->src4_par);
-	if (ret != 0)
-		return -ENOMEM;
+	for (i = 0; i < VSP2_COUNT_RPF; i++) {
+		ret = vsp2_vspm_alloc_vsp_in(vsp2->dev, &vsp2->vspm->in[i]);
+		if (ret != 0)
+			return -ENOMEM;
+
+		/* The palette is only passed to the VSPM for indexed formats,
+		 * see rpf_s_stream().
+		 */
+		vsp2->vspm->osd_lut[i] = devm_kzalloc(vsp2->dev,
+			sizeof(*vsp2->vspm->osd_lut[i]), GFP_KERNEL);
+		if (vsp2->vspm->osd_lut[i] == NULL)
+			return -ENOMEM;
+	}
 
 	vsp_par->dst_par =
 	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->dst_par), GFP_KERNEL);
@@ -263,6 +275,41 @@ static int vsp2_vspm_alloc(struct vsp2_device *vsp2)
 	if (ret != 0)
 		return -ENOMEM;
 
+	vsp_par->ctrl_par->clu =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->clu), GFP_KERNEL);
+	if (vsp_par->ctrl_par->clu == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->hgo =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->hgo), GFP_KERNEL);
+	if (vsp_par->ctrl_par->hgo == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->hgt =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->hgt), GFP_KERNEL);
+	if (vsp_par->ctrl_par->hgt == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->hsi =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->hsi), GFP_KERNEL);
+	if (vsp_par->ctrl_par->hsi == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->hst =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->hst), GFP_KERNEL);
+	if (vsp_par->ctrl_par->hst == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->lut =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->lut), GFP_KERNEL);
+	if (vsp_par->ctrl_par->lut == NULL)
+		return -ENOMEM;
+
+	vsp_par->ctrl_par->sru =
+	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->sru), GFP_KERNEL);
+	if (vsp_par->ctrl_par->sru == NULL)
+		return -ENOMEM;
+
 	vsp_par->ctrl_par->uds =
 	  devm_kzalloc(vsp2->dev, sizeof(*vsp_par->ctrl_par->uds), GFP_KERNEL);
 	if (vsp_par->ctrl_par->uds == NULL)
@@ -322,36 +369,76 @@ static void vsp2_vspm_drv_entry_cb(unsigned long job_id, long result,
 	return;
 }
 
-void vsp2_vspm_drv_entry_work(struct work_struct *work)
+/*
+ * vsp2_vspm_set_layers - Assign the job inputs to the VSPM source parameters
+ * @vsp2: the VSP2 device
+ * @layers: the layers composed by the job, from bottom to top
+ * @num_layers: the number of layers
+ *
+ * The VSPM driver reads the inputs from src1_par to src<rpf_num>_par. Map the
+ * input parameters of the RPFs used by the job to those slots in layer order,
+ * the BRU layer order then always stacks the sources in slot order.
+ */
+void vsp2_vspm_set_layers(struct vsp2_device *vsp2,
+			  const struct vsp2_pipeline_layer *layers,
+			  unsigned int num_layers)
 {
-	long ret = R_VSPM_OK;
+	static const unsigned long lay[] = {
+		VSP_LAY_1, VSP_LAY_2, VSP_LAY_3, VSP_LAY_4,
+	};
 
-	struct vsp2_vspm_entry_work *entry_work;
-	struct vsp2_device *vsp2;
-	VSPM_VSP_PAR *vsp_par;
+	VSPM_VSP_PAR *vsp_par = vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_IN *src[VSP2_COUNT_RPF];
+	unsigned int used = 0;
+	unsigned int n = 0;
+	unsigned int i;
 
-	entry_work = (struct vsp2_vspm_entry_work *)work;
-	vsp2 = entry_work->vsp2;
-	vsp_par = vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	for (i = 0; i < num_layers; ++i) {
+		unsigned int index = layers[i].rpf->entity.index;
+
+		src[n++] = vsp2->vspm->in[index];
+		used |= 1 << index;
+	}
+
+	/* Fill the remaining slots with the unused inputs. */
+	for (i = 0; i < VSP2_COUNT_RPF; ++i) {
+		if (!(used & (1 << i)))
+			src[n++] = vsp2->vspm->in[i];
+	}
+
+	vsp_par->src1_par = src[0];
+	vsp_par->src2_par = src[1];
+	vsp_par->src3_par = src[2];
+	vsp_par->src4_par = src[3];
+	vsp_par->rpf_num = num_layers;
 
 	if (vsp_par->use_module & VSP_BRU_USE) {
 		/* Set lay_order of BRU. */
 		vsp_par->ctrl_par->bru->lay_order = VSP_LAY_VIRTUAL;
 
-		if (vsp_par->rpf_num >= 1)
-			vsp_par->ctrl_par->bru->lay_order |= (VSP_LAY_1 << 4);
+		for (i = 0; i < num_layers; ++i)
+			vsp_par->ctrl_par->bru->lay_order |=
+				lay[i] << ((i + 1) * 4);
+	} else {
+		/* Not use BRU. Set the input to parent layer. */
+		vsp_par->src1_par->pwd = VSP_LAYER_PARENT;
+	}
+}
 
-		if (vsp_par->rpf_num >= 2)
-			vsp_par->ctrl_par->bru->lay_order |= (VSP_LAY_2 << 8);
+void vsp2_vspm_drv_entry_work(struct work_struct *work)
+{
+	long ret = R_VSPM_OK;
+
+	struct vsp2_vspm_entry_work *entry_work;
+	struct vsp2_device *vsp2;
 
-		if (vsp_par->rpf_num >= 3)
-			vsp_par->ctrl_par->bru->lay_order |= (VSP_LAY_3 << 12);
+	entry_work = (struct vsp2_vspm_entry_work *)work;
+	vsp2 = entry_work->vsp2;
 
-		if (vsp_par->rpf_num >= 4)
-			vsp_par->ctrl_par->bru->lay_order |= (VSP_LAY_4 << 16);
-	} else {
-		/* Not use BRU. Set RPF0 to parent layer. */
-		vsp_par->src1_par->pwd = VSP_LAYER_PARENT;
+	/* The job is redundant, complete the frame without submitting it. */
+	if (entry_work->skip) {
+		vsp2_frame_end(vsp2);
+		return;
 	}
 
 	ret = VSPM_lib_Entry(vsp2->vspm->hdl, &vsp2->vspm->job_id,
@@ -369,6 +456,20 @@ void vsp2_vspm_drv_entry_work(struct work_struct *work)
 void vsp2_vspm_drv_entry(struct vsp2_device *vsp2)
 {
 	vsp2->vspm->entry_work.vsp2 = vsp2;
+	vsp2->vspm->entry_work.skip = false;
+
+	schedule_work((struct work_struct *)&vsp2->vspm->entry_work);
+
+	return;
+}
+
+void vsp2_vspm_drv_skip(struct vsp2_device *vsp2)
+{
+	/* The frame end handler takes the pipeline lock held by the caller,
+	 * complete the frame from the work queue.
+	 */
+	vsp2->vspm->entry_work.vsp2 = vsp2;
+	vsp2->vspm->entry_work.skip = true;
 
 	schedule_work((struct work_struct *)&vsp2->vspm->entry_work);
 
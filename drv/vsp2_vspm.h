@@ -75,13 +75,18 @@
 struct vsp2_vspm_entry_work {
 	struct work_struct work;
 	struct vsp2_device *vsp2;
+	bool skip;
 };
 
+struct vsp2_pipeline_layer;
+
 struct vsp2_vspm {
 	unsigned long hdl;
 	unsigned long job_id;
 	char job_pri;
 	VSPM_IP_PAR ip_par;
+	T_VSP_IN *in[VSP2_COUNT_RPF];
+	T_VSP_OSDLUT *osd_lut[VSP2_COUNT_RPF];
 	struct vsp2_vspm_entry_work entry_work;
 };
 
@@ -91,5 +96,10 @@ void vsp2_vspm_param_init(VSPM_IP_PAR *par);
 long vsp2_vspm_drv_init(struct vsp2_device *vsp2);
 long vsp2_vspm_drv_quit(struct vsp2_device *vsp2);
 void vsp2_vspm_drv_entry(struct vsp2_device *vsp2);
+void vsp2_vspm_drv_skip(struct vsp2_device *vsp2);
+
+void vsp2_vspm_set_layers(struct vsp2_device *vsp2,
+			  const struct vsp2_pipeline_layer *layers,
+			  unsigned int num_layers);
 
 #endif /* __VSP2_VSPM_H__ */
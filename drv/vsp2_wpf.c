@@ -75,14 +75,113 @@
  * Controls
  */
 
+/*
+ * wpf_rotation - Compute the VSPM rotation mode
+ * @wpf: the WPF
+ *
+ * A 180 degrees rotation is equivalent to flipping in both directions, and a
+ * 270 degrees rotation to a 90 degrees rotation flipped in both directions.
+ * All combinations of the rotation and flip controls thus map to one of the
+ * eight VSPM rotation modes.
+ */
+static unsigned char wpf_rotation(const struct vsp2_rwpf *wpf)
+{
+	static const unsigned char modes[2][4] = {
+		{ VSP_ROT_OFF, VSP_ROT_H_FLIP, VSP_ROT_V_FLIP, VSP_ROT_180 },
+		{ VSP_ROT_90, VSP_ROT_90_H_FLIP, VSP_ROT_90_V_FLIP, VSP_ROT_270 },
+	};
+	unsigned int flip = (wpf->hflip ? 1 : 0) | (wpf->vflip ? 2 : 0);
+
+	if (wpf->rotate == 180 || wpf->rotate == 270)
+		flip ^= 3;
+
+	return modes[wpf->rotate == 90 || wpf->rotate == 270][flip];
+}
+
 static int wpf_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct vsp2_rwpf *wpf =
 		container_of(ctrl->handler, struct vsp2_rwpf, ctrls);
+	struct vsp2_pipeline *pipe;
 	VSPM_VSP_PAR *vsp_par =
 		wpf->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
 	T_VSP_OUT *vsp_out = vsp_par->dst_par;
 
+	/* The damage rectangle controls are clustered and applied to the next
+	 * job, or to the next output buffer in request mode, as a whole.
+	 */
+	if (ctrl->id == V4L2_CID_VSP2_DAMAGE_LEFT) {
+		struct v4l2_rect damage;
+
+		if (!vsp2_entity_is_streaming(&wpf->entity))
+			return 0;
+
+		damage.left = ctrl->cluster[0]->val;
+		damage.top = ctrl->cluster[1]->val;
+		damage.width = ctrl->cluster[2]->val;
+		damage.height = ctrl->cluster[3]->val;
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		vsp2_pipeline_set_damage(pipe, &damage);
+		return 0;
+	}
+
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_SKIP_REDUNDANT:
+		wpf->skip_redundant = ctrl->val;
+		return 0;
+	case V4L2_CID_VSP2_REQUEST_MODE:
+		if (!vsp2_entity_is_streaming(&wpf->entity)) {
+			wpf->request_mode = ctrl->val;
+			return 0;
+		}
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		vsp2_pipeline_set_request_mode(pipe, wpf, ctrl->val);
+		return 0;
+	case V4L2_CID_VSP2_PRESET:
+		wpf->preset = ctrl->val;
+		return 0;
+	case V4L2_CID_VSP2_PRESET_LOAD:
+		/* The parameters can only be applied to a pipeline. */
+		if (!vsp2_entity_is_streaming(&wpf->entity) || !wpf->preset)
+			return -EBUSY;
+
+		if (!(wpf->presets_valid & (1 << (wpf->preset - 1))))
+			return -EINVAL;
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		return vsp2_pipeline_load_preset(pipe,
+						 &wpf->presets[wpf->preset - 1]);
+	case V4L2_CID_VSP2_PRESET_STORE:
+		/* The parameters can only be captured from a pipeline. */
+		if (!vsp2_entity_is_streaming(&wpf->entity) || !wpf->preset)
+			return -EBUSY;
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		vsp2_pipeline_store_preset(pipe,
+					   &wpf->presets[wpf->preset - 1]);
+		wpf->presets_valid |= 1 << (wpf->preset - 1);
+		return 0;
+	case V4L2_CID_ROTATE:
+		/* Rotating by 90 or 270 degrees swaps the output width and
+		 * height. The control is grabbed while streaming.
+		 */
+		wpf->rotate = ctrl->val;
+		wpf->rotation = wpf_rotation(wpf);
+		vsp2_rwpf_set_source_size(wpf, NULL, V4L2_SUBDEV_FORMAT_ACTIVE,
+					  wpf->rotate);
+		return 0;
+	case V4L2_CID_HFLIP:
+		wpf->hflip = ctrl->val;
+		wpf->rotation = wpf_rotation(wpf);
+		break;
+	case V4L2_CID_VFLIP:
+		wpf->vflip = ctrl->val;
+		wpf->rotation = wpf_rotation(wpf);
+		break;
+	}
+
 	if (!vsp2_entity_is_streaming(&wpf->entity))
 		return 0;
 
@@ -90,14 +189,243 @@ static int wpf_s_ctrl(struct v4l2_ctrl *ctrl)
 	case V4L2_CID_ALPHA_COMPONENT:
 		vsp_out->pad = ctrl->val;
 		wpf->alpha = ctrl->val;
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		vsp2_pipeline_invalidate_job(pipe);
+		break;
+
+	case V4L2_CID_HFLIP:
+	case V4L2_CID_VFLIP:
+		/* Flipping doesn't modify the output size and can be changed
+		 * at any time.
+		 */
+		vsp_out->rotation = wpf->rotation;
+
+		pipe = to_vsp2_pipeline(&wpf->entity.subdev.entity);
+		vsp2_pipeline_invalidate_job(pipe);
 		break;
 	}
 
 	return 0;
 }
 
+static int wpf_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct vsp2_rwpf *wpf =
+		container_of(ctrl->handler, struct vsp2_rwpf, ctrls);
+	unsigned long flags;
+
+	spin_lock_irqsave(&wpf->video.irqlock, flags);
+
+	switch (ctrl->id) {
+	case V4L2_CID_VSP2_FRAME_SEQUENCE:
+		/* The frame timing controls are clustered, report a consistent
+		 * snapshot of the sequence number and times.
+		 */
+		ctrl->cluster[0]->val = wpf->timing.sequence;
+		ctrl->cluster[1]->val64 = wpf->timing.start;
+		ctrl->cluster[2]->val64 = wpf->timing.end;
+		break;
+	case V4L2_CID_VSP2_SKIPPED_JOBS:
+		ctrl->val = wpf->timing.skipped;
+		break;
+	}
+
+	spin_unlock_irqrestore(&wpf->video.irqlock, flags);
+
+	return 0;
+}
+
 static const struct v4l2_ctrl_ops wpf_ctrl_ops = {
 	.s_ctrl = wpf_s_ctrl,
+	.g_volatile_ctrl = wpf_g_volatile_ctrl,
+};
+
+/*
+ * The frame timing controls report the sequence number of the last completed
+ * output buffer along with the monotonic time (in nanoseconds) at which its
+ * processing has been started and completed. The values are overwritten when
+ * the next output buffer completes. They should be read in a single
+ * VIDIOC_G_EXT_CTRLS call after dequeuing a buffer, and only apply to that
+ * buffer when the reported sequence number matches the buffer sequence
+ * number. Otherwise the times of the buffer have been lost.
+ */
+static const struct v4l2_ctrl_config wpf_ctrl_frame_sequence = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_FRAME_SEQUENCE,
+	.name = "Frame Sequence",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 0,
+	.max = 0x7fffffff,
+	.step = 1,
+	.def = 0,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+};
+
+static const struct v4l2_ctrl_config wpf_ctrl_frame_start = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_FRAME_START,
+	.name = "Frame Processing Start Time",
+	.type = V4L2_CTRL_TYPE_INTEGER64,
+	.min = 0,
+	.max = S64_MAX,
+	.step = 1,
+	.def = 0,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+};
+
+static const struct v4l2_ctrl_config wpf_ctrl_frame_end = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_FRAME_END,
+	.name = "Frame Processing End Time",
+	.type = V4L2_CTRL_TYPE_INTEGER64,
+	.min = 0,
+	.max = S64_MAX,
+	.step = 1,
+	.def = 0,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+};
+
+/*
+ * When redundant job skipping is enabled, jobs that would compose the same
+ * layers from the same buffers into the same output buffer as the previous
+ * job are completed without being submitted to the hardware. The skipped jobs
+ * control reports the number of jobs skipped since the stream was started.
+ */
+static const struct v4l2_ctrl_config wpf_ctrl_skip_redundant = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_SKIP_REDUNDANT,
+	.name = "Skip Redundant Jobs",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.min = 0,
+	.max = 1,
+	.step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config wpf_ctrl_skipped_jobs = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_SKIPPED_JOBS,
+	.name = "Skipped Jobs",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 0,
+	.max = 0x7fffffff,
+	.step = 1,
+	.def = 0,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+};
+
+/*
+ * In request mode, the crop rectangles, compose rectangles, alpha values and
+ * background color changes made while streaming are staged. They are bound to
+ * the next output buffer queued and applied together to the job that writes
+ * that buffer, consuming the input buffers queued along with it.
+ */
+static const struct v4l2_ctrl_config wpf_ctrl_request_mode = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_REQUEST_MODE,
+	.name = "Request Mode",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.min = 0,
+	.max = 1,
+	.step = 1,
+	.def = 0,
+};
+
+/*
+ * Presets hold a complete set of per-frame parameters: crop and compose
+ * rectangles, alpha values, background color and BRU inputs enable state.
+ * The preset control selects the preset slot, 0 selects no slot. The store
+ * button saves the current parameters to the selected slot, and the load
+ * button switches to the parameters stored in the selected slot at the next
+ * frame. Presets match the formats they have been stored with, they are
+ * discarded when an input format is switched and when the stream stops.
+ */
+static const struct v4l2_ctrl_config wpf_ctrl_preset = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_PRESET,
+	.name = "Preset",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 0,
+	.max = WPF_NUM_PRESETS,
+	.step = 1,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config wpf_ctrl_preset_store = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_PRESET_STORE,
+	.name = "Store Preset",
+	.type = V4L2_CTRL_TYPE_BUTTON,
+	.min = 0,
+	.max = 0,
+	.step = 0,
+	.def = 0,
+};
+
+static const struct v4l2_ctrl_config wpf_ctrl_preset_load = {
+	.ops = &wpf_ctrl_ops,
+	.id = V4L2_CID_VSP2_PRESET_LOAD,
+	.name = "Load Preset",
+	.type = V4L2_CTRL_TYPE_BUTTON,
+	.min = 0,
+	.max = 0,
+	.step = 0,
+	.def = 0,
+};
+
+/*
+ * The damage rectangle restricts processing to the part of the output image
+ * that has changed, in output image coordinates. The rectangle must cover all
+ * changes since the destination buffer was last written. A zero width or
+ * height disables partial updates.
+ *
+ * The rectangle only applies to the next job, or to the next output buffer
+ * queued in request mode, and must be set again for every frame. Setting the
+ * same rectangle again is thus not ignored.
+ */
+static const struct v4l2_ctrl_config wpf_ctrl_damage[] = {
+	{
+		.ops = &wpf_ctrl_ops,
+		.id = V4L2_CID_VSP2_DAMAGE_LEFT,
+		.name = "Damage Left",
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.min = 0,
+		.max = WPF_MAX_WIDTH - 1,
+		.step = 1,
+		.def = 0,
+		.flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+	}, {
+		.ops = &wpf_ctrl_ops,
+		.id = V4L2_CID_VSP2_DAMAGE_TOP,
+		.name = "Damage Top",
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.min = 0,
+		.max = WPF_MAX_HEIGHT - 1,
+		.step = 1,
+		.def = 0,
+		.flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+	}, {
+		.ops = &wpf_ctrl_ops,
+		.id = V4L2_CID_VSP2_DAMAGE_WIDTH,
+		.name = "Damage Width",
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.min = 0,
+		.max = WPF_MAX_WIDTH,
+		.step = 1,
+		.def = 0,
+		.flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+	}, {
+		.ops = &wpf_ctrl_ops,
+		.id = V4L2_CID_VSP2_DAMAGE_HEIGHT,
+		.name = "Damage Height",
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.min = 0,
+		.max = WPF_MAX_HEIGHT,
+		.step = 1,
+		.def = 0,
+		.flags = V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+	},
 };
 
 /* -----------------------------------------------------------------------------
@@ -108,8 +436,8 @@ static int wpf_s_stream(struct v4l2_subdev *subdev, int enable)
 {
 	struct vsp2_rwpf *wpf = to_rwpf(subdev);
 	struct v4l2_pix_format_mplane *format = &wpf->video.format;
-	const struct v4l2_rect *crop = &wpf->crop;
 	const struct vsp2_format_info *fmtinfo = wpf->video.fmtinfo;
+	unsigned long flags;
 	u32 outfmt = 0;
 	int ret;
 	u32 stride_y = 0;
@@ -123,8 +451,19 @@ static int wpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	if (ret < 0)
 		return ret;
 
-	if (!enable)
+	/* The rotation angle determines the output size and can't be changed
+	 * while streaming.
+	 */
+	v4l2_ctrl_grab(wpf->rotate_ctrl, enable);
+
+	if (!enable) {
+		wpf->presets_valid = 0;
 		return 0;
+	}
+
+	spin_lock_irqsave(&wpf->video.irqlock, flags);
+	wpf->timing.skipped = 0;
+	spin_unlock_irqrestore(&wpf->video.irqlock, flags);
 
 	/* Destination stride. */
 	stride_y = format->plane_fmt[0].bytesperline;
@@ -135,16 +474,11 @@ static int wpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	if (format->num_planes > 1)
 		vsp_out->stride_c	= stride_c;
 
-	vsp_out->width		= crop->width;
-	vsp_out->height		= crop->height;
+	/* The destination size, clipping offsets and addresses are computed
+	 * for every job by vsp2_wpf_configure().
+	 */
 	vsp_out->x_offset	= 0;
 	vsp_out->y_offset	= 0;
-	vsp_out->x_coffset	= crop->left;
-	vsp_out->y_coffset	= crop->top;
-
-	vsp_out->addr = (void *)((unsigned long)wpf->buf_addr[0]);
-	vsp_out->addr_c0 = (void *)((unsigned long)wpf->buf_addr[1]);
-	vsp_out->addr_c1 = (void *)((unsigned long)wpf->buf_addr[2]);
 
 	/* Format */
 	outfmt = fmtinfo->hwfmt << VI6_WPF_OUTFMT_WRFMT_SHIFT;
@@ -161,6 +495,7 @@ static int wpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	if (wpf->entity.formats[RWPF_PAD_SINK].code !=
 	    wpf->entity.formats[RWPF_PAD_SOURCE].code)
 		outfmt |= VI6_WPF_OUTFMT_CSC;
+	outfmt |= vsp2_rwpf_ycbcr_encoding(wpf);
 
 	/* Take the control handler lock to ensure that the PDV value won't be
 	 * changed behind our back by a set control operation.
@@ -189,12 +524,71 @@ static int wpf_s_stream(struct v4l2_subdev *subdev, int enable)
 	vsp_out->athres		= 0;
 	vsp_out->clmd		= VSP_CLMD_NO;
 	vsp_out->ln16		= 0;
-	vsp_out->rotation	= 0;
+	vsp_out->rotation	= wpf->rotation;
 	vsp_out->mirror		= 0;
 
 	return 0;
 }
 
+/*
+ * vsp2_wpf_configure - Configure the WPF geometry for the next job
+ * @wpf: the WPF
+ * @window: the region of the output image composed by the job, in sink pad
+ *	coordinates, or NULL to write the whole output image
+ *
+ * When only a window of the output image is composed, the upstream entities
+ * produce an image of the window size which is written at the corresponding
+ * location in the destination buffer, leaving the rest of the buffer
+ * untouched.
+ */
+void vsp2_wpf_configure(struct vsp2_rwpf *wpf, const struct v4l2_rect *window)
+{
+	const struct v4l2_pix_format_mplane *format = &wpf->video.format;
+	const struct vsp2_format_info *fmtinfo = wpf->video.fmtinfo;
+	const struct v4l2_rect *crop = &wpf->crop;
+	VSPM_VSP_PAR *vsp_par =
+		wpf->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
+	T_VSP_OUT *vsp_out = vsp_par->dst_par;
+	unsigned int left;
+	unsigned int top;
+
+	if (window == NULL) {
+		vsp_out->width		= crop->width;
+		vsp_out->height		= crop->height;
+		vsp_out->x_coffset	= crop->left;
+		vsp_out->y_coffset	= crop->top;
+
+		wpf->offsets[0] = 0;
+		wpf->offsets[1] = 0;
+	} else {
+		left = window->left - crop->left;
+		top = window->top - crop->top;
+
+		vsp_out->width		= window->width;
+		vsp_out->height		= window->height;
+		vsp_out->x_coffset	= 0;
+		vsp_out->y_coffset	= 0;
+
+		wpf->offsets[0] = top * format->plane_fmt[0].bytesperline
+				+ left * fmtinfo->bpp[0] / 8;
+
+		if (format->num_planes > 1)
+			wpf->offsets[1] = top * format->plane_fmt[1].bytesperline
+					/ fmtinfo->vsub
+					+ left * fmtinfo->bpp[1] / fmtinfo->hsub
+					/ 8;
+		else
+			wpf->offsets[1] = 0;
+	}
+
+	vsp_out->addr = (void *)((unsigned long)wpf->buf_addr[0]
+					      + wpf->offsets[0]);
+	vsp_out->addr_c0 = (void *)((unsigned long)wpf->buf_addr[1]
+						  + wpf->offsets[1]);
+	vsp_out->addr_c1 = (void *)((unsigned long)wpf->buf_addr[2]
+						  + wpf->offsets[1]);
+}
+
 /* -----------------------------------------------------------------------------
  * V4L2 Subdevice Operations
  */
@@ -225,17 +619,16 @@ static void wpf_vdev_queue(struct vsp2_video *video,
 			   struct vsp2_video_buffer *buf)
 {
 	struct vsp2_rwpf *wpf = container_of(video, struct vsp2_rwpf, video);
-	VSPM_VSP_PAR *vsp_par =
-		wpf->entity.vsp2->vspm->ip_par.unionIpParam.ptVsp;
-	T_VSP_OUT *vsp_out = vsp_par->dst_par;
 	unsigned int i;
 
+	/* The buffer addresses are programmed by vsp2_wpf_configure() when
+	 * the next job is built, along with the per-frame parameters bound to
+	 * the buffer.
+	 */
 	for (i = 0; i < 3; ++i)
 		wpf->buf_addr[i] = buf->addr[i];
 
-	vsp_out->addr = (void *)((unsigned long)buf->addr[0]);
-	vsp_out->addr_c0 = (void *)((unsigned long)buf->addr[1]);
-	vsp_out->addr_c1 = (void *)((unsigned long)buf->addr[2]);
+	wpf->params = buf->has_params ? &buf->params : NULL;
 }
 
 static const struct vsp2_video_operations wpf_vdev_ops = {
@@ -252,6 +645,7 @@ struct vsp2_rwpf *vsp2_wpf_create(struct vsp2_device *vsp2, unsigned int index)
 	struct vsp2_video *video;
 	struct vsp2_rwpf *wpf;
 	unsigned int flags;
+	unsigned int i;
 	int ret;
 
 	wpf = devm_kzalloc(vsp2->dev, sizeof(*wpf), GFP_KERNEL);
@@ -282,9 +676,33 @@ struct vsp2_rwpf *vsp2_wpf_create(struct vsp2_device *vsp2, unsigned int index)
 	vsp2_entity_init_formats(subdev, NULL);
 
 	/* Initialize the control handler. */
-	v4l2_ctrl_handler_init(&wpf->ctrls, 1);
+	v4l2_ctrl_handler_init(&wpf->ctrls, 17);
 	v4l2_ctrl_new_std(&wpf->ctrls, &wpf_ctrl_ops, V4L2_CID_ALPHA_COMPONENT,
 			  0, 255, 1, 255);
+	wpf->rotate_ctrl = v4l2_ctrl_new_std(&wpf->ctrls, &wpf_ctrl_ops,
+					     V4L2_CID_ROTATE, 0, 270, 90, 0);
+	v4l2_ctrl_new_std(&wpf->ctrls, &wpf_ctrl_ops, V4L2_CID_HFLIP,
+			  0, 1, 1, 0);
+	v4l2_ctrl_new_std(&wpf->ctrls, &wpf_ctrl_ops, V4L2_CID_VFLIP,
+			  0, 1, 1, 0);
+	wpf->timing_ctrls[0] = v4l2_ctrl_new_custom(&wpf->ctrls,
+						    &wpf_ctrl_frame_sequence,
+						    NULL);
+	wpf->timing_ctrls[1] = v4l2_ctrl_new_custom(&wpf->ctrls,
+						    &wpf_ctrl_frame_start, NULL);
+	wpf->timing_ctrls[2] = v4l2_ctrl_new_custom(&wpf->ctrls,
+						    &wpf_ctrl_frame_end, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_skip_redundant, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_skipped_jobs, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_request_mode, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_preset, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_preset_store, NULL);
+	v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_preset_load, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(wpf_ctrl_damage); ++i)
+		wpf->damage_ctrls[i] =
+			v4l2_ctrl_new_custom(&wpf->ctrls, &wpf_ctrl_damage[i],
+					     NULL);
 
 	wpf->entity.subdev.ctrl_handler = &wpf->ctrls;
 
@@ -295,6 +713,9 @@ struct vsp2_rwpf *vsp2_wpf_create(struct vsp2_device *vsp2, unsigned int index)
 		goto error;
 	}
 
+	v4l2_ctrl_cluster(ARRAY_SIZE(wpf->timing_ctrls), wpf->timing_ctrls);
+	v4l2_ctrl_cluster(ARRAY_SIZE(wpf->damage_ctrls), wpf->damage_ctrls);
+
 	/* Initialize the video device. */
 	video = &wpf->video;
 